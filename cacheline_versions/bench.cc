@@ -1,71 +1,168 @@
-#include <assert.h>
+/**
+ * @file bench.cc
+ * @brief Update and read latency of the versioned object store, vs. redo
+ * logging
+ *
+ * For each object size, the region is split into three parts:
+ *  - A VersionedStore, whose updates are in place, and whose reads check the
+ *    cacheline versions
+ *  - Plain in-place objects, updated by redo logging. Reads are plain copies.
+ *  - A CircularLog for the redo records. Each update appends the object to
+ *    the log, then copies it in place. Log truncation happens when the log
+ *    is full, and isn't timed.
+ */
+
 #include <gflags/gflags.h>
 #include <libpmem.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/types.h>
-#include <time.h>
-#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <numeric>
 #include <pcg/pcg_random.hpp>
+#include <sstream>
+#include <vector>
 #include "../common.h"
+#include "../log_store/circular_log.h"
+#include "../utils/parse_list.h"
+#include "../utils/pmem_region.h"
+#include "../utils/result_writer.h"
 #include "../utils/timer.h"
-#include "config.h"
+#include "versioned_store.h"
 
-DEFINE_uint64(use_pmem, 1, "Use persistent memory");
-DEFINE_uint64(object_size, KB(4), "Size of objects");
+DEFINE_string(pmem_file, "/dev/dax0.0",
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram");
+DEFINE_uint64(region_size, GB(4), "Bytes of pmem used, including the log");
+DEFINE_string(sizes, "256,1024,4096,16384,65536",
+              "Comma-separated object sizes in bytes");
+DEFINE_uint64(num_ops, 100000, "Operations per configuration");
+DEFINE_string(format, "csv", "Result format: csv or json");
+DEFINE_string(output_file, "",
+              "Append results to this file. Empty means stdout.");
 
-// static constexpr const char *kFileName = "/mnt/pmem12/raft_log";
-static constexpr const char *kFileName = "/dev/dax0.0";
-static constexpr bool kUsePmem = true;
-static constexpr size_t kFileSize = GB(32);
+static constexpr size_t kLogSize = MB(64);
 
-int main(int argc, char **argv) {
-  gflags::ParseCommandLineFlags(&argc, &argv, true);
-  rt_assert(getuid() == 0, "You need to be root to run this benchmark");
-
-  uint8_t *pbuf;
-  size_t mapped_len;
-
-  if (FLAGS_use_pmem == 1) {
-    printf("Using persistent memory buffer, size %zu\n", FLAGS_object_size);
-    int is_pmem;
-    pbuf = reinterpret_cast<uint8_t *>(
-        pmem_map_file(kFileName, 0, 0, 0666, &mapped_len, &is_pmem));
-
-    rt_assert(pbuf != nullptr);
-    rt_assert(mapped_len >= kFileSize);
-  } else {
-    printf("Using volatile memory buffer\n");
-    pbuf = reinterpret_cast<uint8_t *>(malloc(kFileSize));
-  }
+/// Write a row with the average, median and 99th percentile of \p cycles
+static void write_latency_row(ResultWriter &writer, const char *op,
+                              size_t size, std::vector<size_t> &cycles,
+                              double freq_ghz) {
+  std::sort(cycles.begin(), cycles.end());
+  ResultRow row;
+  row.add("op", op).add("size", size);
+  row.add("avg_ns", std::accumulate(cycles.begin(), cycles.end(), 0.0) /
+                        (cycles.size() * freq_ghz));
+  row.add("p50_ns", cycles.at(cycles.size() / 2) / freq_ghz);
+  row.add("p99_ns", cycles.at(cycles.size() * 99 / 100) / freq_ghz);
+  writer.write(row);
+}
+
+/// Measure one object size, with \p space bytes each for the versioned store
+/// and the redo-logged objects
+void bench_one(uint8_t *pbuf, size_t space, size_t object_size,
+               double freq_ghz, ResultWriter &writer) {
+  const size_t num_objects =
+      (space - VersionedStore::get_metadata_space()) /
+      VersionedStore::get_slot_size(object_size);
+  const size_t plain_slot_size = roundup<256>(object_size);
+  rt_assert(num_objects > 0 && num_objects * plain_slot_size <= space,
+            "Region too small for the object size");
+
+  VersionedStore store(pbuf, space, num_objects, object_size, true);
+  uint8_t *plain_objects = pbuf + space;
+  CircularLog log(pbuf + 2 * space, kLogSize, true);
+
+  // Redo records are an object ID followed by the object
+  std::vector<uint8_t> record(sizeof(size_t) + object_size, 31);
+  uint8_t *data = &record[sizeof(size_t)];
+  std::vector<uint8_t> out(object_size);
+
+  // Write every object once, so reads find valid objects
+  for (size_t i = 0; i < num_objects; i++) store.update(i, data);
+  pmem_memset_persist(plain_objects, 31, num_objects * plain_slot_size);
 
-  size_t iter = 0;
-  size_t sum = 0;
   pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+  std::vector<size_t> cycles(FLAGS_num_ops);
+
+  for (size_t i = 0; i < FLAGS_num_ops; i++) {
+    const size_t obj_id = pcg() % num_objects;
+    data[0]++;
+    const size_t start_tsc = timer::Start();
+    store.update(obj_id, data);
+    cycles[i] = timer::Stop() - start_tsc;
+  }
+  write_latency_row(writer, "versioned_update", object_size, cycles, freq_ghz);
+
+  for (size_t i = 0; i < FLAGS_num_ops; i++) {
+    const size_t obj_id = pcg() % num_objects;
+    memcpy(record.data(), &obj_id, sizeof(size_t));
+    data[0]++;
+
+    if (log.get_tail() + CircularLog::get_entry_space(record.size()) -
+            log.get_head() >
+        log.get_capacity()) {
+      // Truncate the whole log. A real store would apply the log lazily.
+      std::vector<uint8_t> scratch(record.size());
+      size_t scratch_size;
+      while (log.read_next(scratch.data(), &scratch_size, nullptr)) {
+      }
+      log.trim(log.get_read_cursor());
+    }
 
-  while (true) {
-    size_t rand = pcg();
-    size_t offset = roundup<64>(rand % kFileSize);
-    if (offset + FLAGS_object_size >= kFileSize) continue;
+    const size_t start_tsc = timer::Start();
+    rt_assert(log.append(record.data(), record.size()) !=
+              CircularLog::kInvalidLsn);
+    pmem_memcpy_persist(&plain_objects[obj_id * plain_slot_size], data,
+                        object_size);
+    emul_persist_delay(object_size);
+    cycles[i] = timer::Stop() - start_tsc;
+  }
+  write_latency_row(writer, "redo_update", object_size, cycles, freq_ghz);
 
-    uint8_t *obj = &pbuf[offset];
-    for (size_t i = 0; i < FLAGS_object_size / 64; i++) sum += obj[i * 64];
+  size_t sum = 0;
+  for (size_t i = 0; i < FLAGS_num_ops; i++) {
+    const size_t obj_id = pcg() % num_objects;
+    const size_t start_tsc = timer::Start();
+    rt_assert(store.read(obj_id, out.data(), nullptr), "Torn object");
+    cycles[i] = timer::Stop() - start_tsc;
+    sum += out[0];
+  }
+  write_latency_row(writer, "versioned_read", object_size, cycles, freq_ghz);
 
-    struct timespec bench_start;
-    clock_gettime(CLOCK_REALTIME, &bench_start);
+  for (size_t i = 0; i < FLAGS_num_ops; i++) {
+    const size_t obj_id = pcg() % num_objects;
+    const size_t start_tsc = timer::Start();
+    memcpy(out.data(), &plain_objects[obj_id * plain_slot_size], object_size);
+    cycles[i] = timer::Stop() - start_tsc;
+    sum += out[0];
+  }
+  write_latency_row(writer, "plain_read", object_size, cycles, freq_ghz);
+  fprintf(stderr, "Read sum = %zu\n", sum);
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  const std::vector<size_t> sizes = parse_size_list(FLAGS_sizes);
+  rt_assert(FLAGS_num_ops > 0, "Need at least one operation");
+  rt_assert(FLAGS_region_size > kLogSize, "Region too small for the log");
 
-    for (size_t i = 0; i < FLAGS_object_size / 64; i++) obj[i * 64] = iter % 2;
-    memset(obj, iter, FLAGS_object_size);
-    for (size_t i = 0; i < FLAGS_object_size / 64; i++) obj[i * 64] = iter % 3;
+  ResultWriter writer(FLAGS_format, FLAGS_output_file);
+  const double freq_ghz = measure_rdtsc_freq();
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, FLAGS_region_size);
+  const size_t space = (FLAGS_region_size - kLogSize) / 2 / 256 * 256;
 
-    printf("Object size %zu, time = %.2f us, bw = %.2f GB/s, size %zu\n",
-           FLAGS_object_size, sec_since(bench_start) * 1000000,
-           FLAGS_object_size / (1024 * 1024 * 1024.0 * sec_since(bench_start)),
-           FLAGS_object_size);
+  ResultRow metadata;
+  metadata.add("pmem_file", FLAGS_pmem_file);
+  metadata.add("pmem_mode", pmem_backend_str(region.backend));
+  metadata.add("region_size", static_cast<size_t>(FLAGS_region_size));
+  metadata.add("rdtsc_freq_ghz", freq_ghz);
+  writer.write_metadata(metadata);
 
-    iter++;
+  for (size_t object_size : sizes) {
+    rt_assert(object_size > 0, "Object sizes must be positive");
+    bench_one(region.buf, space, object_size, freq_ghz, writer);
   }
 
-  if (kUsePmem) pmem_unmap(pbuf, mapped_len);
+  unmap_pmem_region(region);
+  exit(0);
 }
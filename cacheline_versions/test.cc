@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <libpmem.h>
+#include "versioned_store.h"
+
+static constexpr size_t kStoreSize = MB(4);  // Including store metadata
+static constexpr size_t kNumObjects = 64;
+
+class VersionedStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    region = map_pmem_region(get_test_pmem_spec(), kStoreSize);
+    pbuf = region.buf;
+  }
+
+  void TearDown() override { unmap_pmem_region(region); }
+
+  // Fill buf with a pattern identifying the object and version
+  static void make_object(size_t obj_id, size_t version, uint8_t *buf,
+                          size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      buf[i] = static_cast<uint8_t>(obj_id * 7 + version * 13 + i);
+    }
+  }
+
+  // Check that the store's object has the pattern for version
+  static void check_object(const VersionedStore &store, size_t obj_id,
+                           size_t version) {
+    const size_t size = store.get_object_size();
+    std::vector<uint8_t> expected(size), actual(size);
+    size_t actual_version = 0;
+    make_object(obj_id, version, expected.data(), size);
+    ASSERT_TRUE(store.read(obj_id, actual.data(), &actual_version));
+    ASSERT_EQ(actual_version, version);
+    ASSERT_EQ(memcmp(expected.data(), actual.data(), size), 0);
+  }
+
+  PmemRegion region;
+  uint8_t *pbuf = nullptr;
+};
+
+TEST_F(VersionedStoreTest, UpdateAndRead) {
+  // Sizes that fill lines exactly, and ones that leave a partial line
+  for (size_t object_size : {1ul, 56ul, 100ul, 256ul, 4096ul}) {
+    VersionedStore store(pbuf, kStoreSize, kNumObjects, object_size, true);
+    std::vector<uint8_t> buf(object_size);
+    ASSERT_FALSE(store.read(0, buf.data(), nullptr));
+
+    for (size_t version = 1; version <= 3; version++) {
+      for (size_t obj_id = 0; obj_id < kNumObjects; obj_id++) {
+        make_object(obj_id, version, buf.data(), object_size);
+        store.update(obj_id, buf.data());
+      }
+    }
+    for (size_t obj_id = 0; obj_id < kNumObjects; obj_id++) {
+      check_object(store, obj_id, 3);
+    }
+  }
+}
+
+TEST_F(VersionedStoreTest, Recovery) {
+  static constexpr size_t kObjectSize = 1000;
+  std::vector<uint8_t> buf(kObjectSize);
+  {
+    VersionedStore store(pbuf, kStoreSize, kNumObjects, kObjectSize, true);
+    for (size_t obj_id = 0; obj_id < kNumObjects; obj_id += 2) {
+      for (size_t version = 1; version <= obj_id + 1; version++) {
+        make_object(obj_id, version, buf.data(), kObjectSize);
+        store.update(obj_id, buf.data());
+      }
+    }
+  }
+
+  VersionedStore store(pbuf, kStoreSize, kNumObjects, kObjectSize, false);
+  ASSERT_TRUE(store.get_torn_objects().empty());
+  for (size_t obj_id = 0; obj_id < kNumObjects; obj_id++) {
+    if (obj_id % 2 == 0) {
+      check_object(store, obj_id, obj_id + 1);
+    } else {
+      ASSERT_FALSE(store.read(obj_id, buf.data(), nullptr));
+    }
+  }
+
+  // Updates continue from the recovered version
+  make_object(2, 4, buf.data(), kObjectSize);
+  store.update(2, buf.data());
+  check_object(store, 2, 4);
+}
+
+TEST_F(VersionedStoreTest, TornObject) {
+  static constexpr size_t kObjectSize = 4096;
+  static constexpr size_t kTornObject = 5;
+  std::vector<uint8_t> buf(kObjectSize);
+  {
+    VersionedStore store(pbuf, kStoreSize, kNumObjects, kObjectSize, true);
+    for (size_t obj_id = 0; obj_id < kNumObjects; obj_id++) {
+      make_object(obj_id, 1, buf.data(), kObjectSize);
+      store.update(obj_id, buf.data());
+    }
+  }
+
+  // Simulate a crash during an update: one line has the next version
+  auto *lines = reinterpret_cast<VersionedStore::Line *>(
+      pbuf + VersionedStore::get_metadata_space() +
+      kTornObject * VersionedStore::get_slot_size(kObjectSize));
+  const size_t next_version = 2;
+  pmem_memcpy_persist(&lines[10].version, &next_version, sizeof(size_t));
+
+  VersionedStore store(pbuf, kStoreSize, kNumObjects, kObjectSize, false);
+  ASSERT_EQ(store.get_torn_objects(), std::vector<size_t>{kTornObject});
+  ASSERT_FALSE(store.read(kTornObject, buf.data(), nullptr));
+  check_object(store, kTornObject + 1, 1);
+
+  // Rewriting a torn object makes it whole, with a version above all its lines
+  make_object(kTornObject, 3, buf.data(), kObjectSize);
+  store.update(kTornObject, buf.data());
+  check_object(store, kTornObject, 3);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
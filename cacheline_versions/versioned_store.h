@@ -0,0 +1,219 @@
+/**
+ * @file versioned_store.h
+ * @brief A persistent store of fixed-size objects that are updated in place
+ * without a log, with a version in every cacheline to detect torn updates.
+ * Header-only.
+ */
+#pragma once
+
+#include <emmintrin.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "../common.h"
+#include "../utils/pmem_region.h"
+
+/**
+ * Layout on pmem:
+ *  - Superblock
+ *  - Object slots, each a run of 64-byte lines, padded to whole XPLines
+ *
+ * Each line has the object's version, then kPayloadPerLine bytes of the
+ * object. An update writes all of an object's lines with the next version and
+ * persists them with a single fence. A crash during an update can leave lines
+ * with different versions, so reads and recovery check that all of an
+ * object's lines have the same version. Version zero means never written.
+ *
+ * Lines are written with non-temporal stores, which reach pmem as whole
+ * 64-byte writes in practice. x86 guarantees only 8-byte failure atomicity, so
+ * torn detection is best effort within a line.
+ *
+ * A torn object's old contents are lost. Recovery reports torn objects, and
+ * the next update of one makes it whole again.
+ *
+ * Not thread-safe.
+ */
+class VersionedStore {
+ public:
+  static constexpr size_t kMagic = 0x76657273746f7265;  // "verstore"
+  static constexpr size_t kLineSize = 64;
+  static constexpr size_t kPayloadPerLine = kLineSize - sizeof(size_t);
+
+  struct Superblock {
+    size_t magic;        // kMagic iff the store was created successfully
+    size_t num_objects;  // Number of object slots
+    size_t object_size;  // Bytes in each object
+  };
+
+  struct Line {
+    size_t version;
+    uint8_t payload[kPayloadPerLine];
+  };
+  static_assert(sizeof(Line) == kLineSize, "");
+
+  /**
+   * @brief Construct a store
+   *
+   * @param pbuf The start address of the store on persistent memory
+   *
+   * @param pbuf_size The bytes available at pbuf, including metadata
+   *
+   * @param create_new If true, an empty store is created. If false, the store
+   * is recovered from the prior pmem contents, and \p num_objects and
+   * \p object_size must match the store's.
+   */
+  VersionedStore(uint8_t *pbuf, size_t pbuf_size, size_t num_objects,
+                 size_t object_size, bool create_new)
+      : sb(reinterpret_cast<Superblock *>(pbuf)),
+        slots_base_addr(pbuf + get_metadata_space()),
+        num_objects(num_objects),
+        object_size(object_size),
+        lines_per_object(get_lines_per_object(object_size)),
+        slot_size(get_slot_size(object_size)),
+        v_versions(num_objects, 0) {
+    rt_assert(object_size > 0, "VersionedStore: empty objects");
+    rt_assert(pbuf_size >= get_reqd_space(num_objects, object_size),
+              "VersionedStore: pmem buffer too small");
+
+    if (create_new) {
+      pmem_memset_persist(slots_base_addr, 0, num_objects * slot_size);
+
+      // The magic is persisted separately after everything else, so a
+      // partially-created store is detected even over a stale magic
+      Superblock v_sb;
+      v_sb.magic = 0;
+      v_sb.num_objects = num_objects;
+      v_sb.object_size = object_size;
+      pmem_memcpy_persist(sb, &v_sb, sizeof(v_sb));
+
+      const size_t magic = kMagic;
+      pmem_memcpy_persist(&sb->magic, &magic, sizeof(magic));
+    } else {
+      rt_assert(sb->magic == kMagic, "VersionedStore: no store found on pmem");
+      rt_assert(sb->num_objects == num_objects &&
+                    sb->object_size == object_size,
+                "VersionedStore: geometry differs from the store's");
+      recover();
+    }
+  }
+
+  /// The pmem needed for store metadata, before the object slots
+  static size_t get_metadata_space() {
+    return roundup<256>(sizeof(Superblock));
+  }
+
+  /// The number of lines that hold an object of \p object_size bytes
+  static size_t get_lines_per_object(size_t object_size) {
+    return (object_size + kPayloadPerLine - 1) / kPayloadPerLine;
+  }
+
+  /// The pmem used by one object slot, padded so slots don't share XPLines
+  static size_t get_slot_size(size_t object_size) {
+    return roundup<256>(get_lines_per_object(object_size) * kLineSize);
+  }
+
+  /// The pmem needed for a store, including metadata
+  static size_t get_reqd_space(size_t num_objects, size_t object_size) {
+    return get_metadata_space() + num_objects * get_slot_size(object_size);
+  }
+
+  /// Overwrite object \p obj_id with object_size bytes from \p data, and
+  /// persist it
+  void update(size_t obj_id, const uint8_t *data) {
+    const size_t version = ++v_versions.at(obj_id);
+    Line *dst = get_slot(obj_id);
+
+    Line line;
+    line.version = version;
+    for (size_t i = 0; i < lines_per_object; i++) {
+      const size_t offset = i * kPayloadPerLine;
+      const size_t len = std::min(kPayloadPerLine, object_size - offset);
+      memcpy(line.payload, data + offset, len);
+      if (len < kPayloadPerLine) {
+        memset(line.payload + len, 0, kPayloadPerLine - len);
+      }
+      write_line_nt(&dst[i], &line);
+    }
+
+    _mm_sfence();
+    emul_persist_delay(lines_per_object * kLineSize);
+  }
+
+  /**
+   * @brief Copy object \p obj_id to \p out_data, which must have space for
+   * object_size bytes
+   *
+   * @param out_version If non-null, this is filled with the object's version
+   *
+   * @return True iff the object was written and all its lines have the same
+   * version. If false, out_data's contents are unspecified.
+   */
+  bool read(size_t obj_id, uint8_t *out_data, size_t *out_version) const {
+    const Line *src = get_slot(obj_id);
+    const size_t version = src[0].version;
+    if (version == 0) return false;
+
+    for (size_t i = 0; i < lines_per_object; i++) {
+      if (src[i].version != version) return false;
+      const size_t offset = i * kPayloadPerLine;
+      memcpy(out_data + offset, src[i].payload,
+             std::min(kPayloadPerLine, object_size - offset));
+    }
+
+    if (out_version != nullptr) *out_version = version;
+    return true;
+  }
+
+  /// Return the objects that recovery found torn
+  const std::vector<size_t> &get_torn_objects() const { return torn_objects; }
+
+  /// Return the version of the last update to object \p obj_id
+  size_t get_version(size_t obj_id) const { return v_versions.at(obj_id); }
+
+  size_t get_num_objects() const { return num_objects; }
+  size_t get_object_size() const { return object_size; }
+
+ private:
+  Line *get_slot(size_t obj_id) const {
+    rt_assert(obj_id < num_objects, "VersionedStore: invalid object ID");
+    return reinterpret_cast<Line *>(slots_base_addr + obj_id * slot_size);
+  }
+
+  /// Copy one line to pmem with non-temporal stores, without a fence
+  static inline void write_line_nt(Line *dst, const Line *src) {
+    auto *d = reinterpret_cast<__m128i *>(dst);
+    auto *s = reinterpret_cast<const __m128i *>(src);
+    for (size_t i = 0; i < kLineSize / sizeof(__m128i); i++) {
+      _mm_stream_si128(&d[i], _mm_loadu_si128(&s[i]));
+    }
+  }
+
+  /// Rebuild the DRAM versions, and find objects with mismatched versions.
+  /// Later updates of a torn object continue from its largest version.
+  void recover() {
+    for (size_t obj_id = 0; obj_id < num_objects; obj_id++) {
+      const Line *lines = get_slot(obj_id);
+      size_t max_version = 0;
+      bool torn = false;
+      for (size_t i = 0; i < lines_per_object; i++) {
+        if (lines[i].version != lines[0].version) torn = true;
+        max_version = std::max(max_version, lines[i].version);
+      }
+
+      v_versions[obj_id] = max_version;
+      if (torn) torn_objects.push_back(obj_id);
+    }
+  }
+
+  Superblock *sb;
+  uint8_t *slots_base_addr;
+  const size_t num_objects;
+  const size_t object_size;
+  const size_t lines_per_object;
+  const size_t slot_size;
+
+  std::vector<size_t> v_versions;  // Version of each object's last update
+  std::vector<size_t> torn_objects;
+};
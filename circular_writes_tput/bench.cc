@@ -1,6 +1,14 @@
+/**
+ * @file bench.cc
+ * @brief Increment throughput of rotating counters, for a compile-time grid of
+ * buffer counts, strides and flush methods. All configurations are swept in
+ * one run.
+ */
+
 #include <assert.h>
 #include <gflags/gflags.h>
 #include <libpmem.h>
+#include <malloc.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,72 +16,88 @@
 #include <time.h>
 #include <unistd.h>
 #include <algorithm>
+#include <initializer_list>
 #include <vector>
 #include "../common.h"
-#include "../utils/timer.h"
-#include "config.h"
-
-// Config parameters:
-// FLAGS_num_counters: Number of counters emulating one counter
-// FLAGS_stride_size: Distance between counters
+#include "../log_store/rotating_counter.h"
 
 // static constexpr const char *kFileName = "/mnt/pmem12/raft_log";
 static constexpr const char *kFileName = "/dev/dax0.0";
 static constexpr size_t kNumIters = 1000000;
-static constexpr bool kUsePmem = true;
-static constexpr bool kUseNtStore = true;
 
-DEFINE_uint64(num_counters, 16, "Number of counters to rotate on");
-DEFINE_uint64(stride_size, 256, "Stride size");
+// Space reserved for one counter, enough for the largest config in the grid
+static constexpr size_t kMaxCounterSize = MB(1);
+
+DEFINE_uint64(use_pmem, 1, "Use persistent memory");
+DEFINE_uint64(num_measurements, 5, "Measurements per configuration");
+
+/// Measure one counter configuration. Print the median increments/s.
+template <size_t kNumBuffers, size_t kBufferSize, FlushMethod kFlushMethod>
+void bench_one(uint8_t *pbuf) {
+  using CounterT = RotatingCounter<kNumBuffers, kBufferSize, kFlushMethod>;
+  static_assert(kNumBuffers * kBufferSize <= kMaxCounterSize, "");
+
+  CounterT ctr(pbuf, true /* create_new */);
+  std::vector<double> mops_vec;
+
+  for (size_t msr = 0; msr < FLAGS_num_measurements; msr++) {
+    struct timespec bench_start;
+    clock_gettime(CLOCK_REALTIME, &bench_start);
+
+    for (size_t i = 0; i < kNumIters; i++) ctr.increment_rotate(1);
+    mops_vec.push_back(kNumIters / (sec_since(bench_start) * 1000000));
+  }
+
+  std::sort(mops_vec.begin(), mops_vec.end());
+  printf("%s %zu %zu %.2f\n", flush_method_str(kFlushMethod), kNumBuffers,
+         kBufferSize, mops_vec.at(mops_vec.size() / 2));
+  fflush(stdout);
+}
+
+/// Measure one flush method and stride with several buffer counts
+template <FlushMethod kFlushMethod, size_t kBufferSize, size_t... kNumBuffers>
+void bench_num_buffers(uint8_t *pbuf) {
+  (void)std::initializer_list<int>{
+      (bench_one<kNumBuffers, kBufferSize, kFlushMethod>(pbuf), 0)...};
+}
+
+/// Measure one flush method with all strides and buffer counts in the grid
+template <FlushMethod kFlushMethod>
+void bench_flush_method(uint8_t *pbuf) {
+  bench_num_buffers<kFlushMethod, 64, 1, 2, 3, 4, 5, 8, 16, 32>(pbuf);
+  bench_num_buffers<kFlushMethod, 256, 1, 2, 3, 4, 5, 8, 16, 32>(pbuf);
+  bench_num_buffers<kFlushMethod, 4096, 1, 2, 3, 4, 5, 8, 16, 32>(pbuf);
+}
 
 int main(int argc, char **argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
-  rt_assert(getuid() == 0, "You need to be root to run this benchmark");
-  rt_assert(FLAGS_stride_size >= sizeof(size_t), "");
-  rt_assert(FLAGS_stride_size % sizeof(size_t) == 0, "");
+  rt_assert(FLAGS_num_measurements > 0, "Need at least one measurement");
 
   uint8_t *pbuf;
-  size_t mapped_len;
+  size_t mapped_len = 0;
 
-  if (kUsePmem) {
+  if (FLAGS_use_pmem == 1) {
+    rt_assert(getuid() == 0, "You need to be root to run this benchmark");
     printf("Using persistent memory buffer\n");
     int is_pmem;
     pbuf = reinterpret_cast<uint8_t *>(
         pmem_map_file(kFileName, 0, 0, 0666, &mapped_len, &is_pmem));
 
     rt_assert(pbuf != nullptr);
-    rt_assert(mapped_len >= FLAGS_num_counters * FLAGS_stride_size);
+    rt_assert(mapped_len >= kMaxCounterSize);
   } else {
     printf("Using DRAM buffer\n");
-    pbuf = reinterpret_cast<uint8_t *>(
-        malloc(FLAGS_num_counters * FLAGS_stride_size));
+    pbuf = reinterpret_cast<uint8_t *>(memalign(4096, kMaxCounterSize));
   }
 
-  size_t counter_val = 1;
-  size_t counter_idx = 0;
-  for (size_t msr = 0; msr < 5; msr++) {
-    struct timespec bench_start;
-    clock_gettime(CLOCK_REALTIME, &bench_start);
-
-    for (size_t i = 0; i < kNumIters; i++) {
-      size_t buffer_offset = counter_idx * FLAGS_stride_size;
-
-      if (kUseNtStore) {
-        pmem_memcpy_persist(&pbuf[buffer_offset], &counter_val, sizeof(size_t));
-      } else {
-        *reinterpret_cast<size_t *>(&pbuf[buffer_offset]) = counter_val;
-        pmem_clwb(&pbuf[buffer_offset]);
-        sfence();
-      }
+  printf("flush_method num_buffers stride_size M_increments_per_sec\n");
+  bench_flush_method<FlushMethod::kNtStore>(pbuf);
+  bench_flush_method<FlushMethod::kClwb>(pbuf);
+  bench_flush_method<FlushMethod::kClflushopt>(pbuf);
 
-      counter_idx++;
-      if (counter_idx == FLAGS_num_counters) counter_idx = 0;
-      counter_val++;
-    }
-
-    printf("num_counters %zu, stride size %zu: %.2f M/s.\n", FLAGS_num_counters,
-           FLAGS_stride_size, kNumIters / (sec_since(bench_start) * 1000000));
+  if (FLAGS_use_pmem == 1) {
+    pmem_unmap(pbuf, mapped_len);
+  } else {
+    free(pbuf);
   }
-
-  if (kUsePmem) pmem_unmap(pbuf, mapped_len);
 }
@@ -1,37 +1,260 @@
+/**
+ * @file hog.cc
+ * @brief Generate pmem bandwidth interference
+ *
+ * By default, the hog copies to pmem in an infinite loop, to be run alongside
+ * another benchmark. With --interference, it runs background threads that
+ * generate a read/write bandwidth mix at each target in --bg_rates, while
+ * foreground threads measure read and write latency percentiles. Each row
+ * reports the latency inflation over the run without background load.
+ */
 #include <assert.h>
+#include <gflags/gflags.h>
+#include <immintrin.h>
 #include <libpmem.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include "../common.h"
+#include "../utils/numa_topology.h"
+#include "../utils/parse_list.h"
+#include "../utils/pmem_region.h"
+#include "../utils/result_writer.h"
 
 // static constexpr const char *kFileName = "/mnt/pmem12/raft_log";
 static constexpr const char *kFileName = "/dev/dax0.0";
 static constexpr size_t kPmemFileSize = GB(8);
 
-int main() {
-  rt_assert(getuid() == 0, "You need to be root to run this benchmark");
-  uint8_t *pbuf;
-  size_t mapped_len;
+DEFINE_string(pmem_file, kFileName,
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram");
+DEFINE_uint64(region_size, kPmemFileSize, "Bytes of pmem used");
+DEFINE_bool(interference, false,
+            "Measure foreground latency under background load, instead of "
+            "hogging forever");
+DEFINE_uint64(bg_threads, 4, "Background threads");
+DEFINE_double(bg_write_fraction, 0.5,
+              "Fraction of background bytes that are writes");
+DEFINE_string(bg_rates, "0,1,2,4,8,max",
+              "Comma-separated background targets in GB/s. max is "
+              "unthrottled.");
+DEFINE_uint64(fg_threads, 1, "Foreground latency-probing threads");
+DEFINE_uint64(fg_size, 256, "Bytes per foreground read or write");
+DEFINE_uint64(fg_ops, 200000, "Foreground reads, and writes, per thread");
+DEFINE_string(format, "csv", "Result format: csv or json");
+DEFINE_string(output_file, "",
+              "Append results to this file. Empty means stdout.");
 
-  int is_pmem;
-  pbuf = reinterpret_cast<uint8_t *>(
-      pmem_map_file(kFileName, 0, 0, 0666, &mapped_len, &is_pmem));
-
-  rt_assert(pbuf != nullptr);
-  rt_assert(mapped_len >= kPmemFileSize);
+static constexpr size_t kBgChunkSize = KB(64);  // Bytes per background copy
 
+/// Copy to pmem forever
+void hog(uint8_t *pbuf, size_t region_size) {
   size_t iter = 0;
-  auto *buf = reinterpret_cast<uint8_t *>(malloc(kPmemFileSize));
+  auto *buf = reinterpret_cast<uint8_t *>(malloc(region_size));
 
   while (true) {
     struct timespec start;
     clock_gettime(CLOCK_REALTIME, &start);
-    pmem_memcpy_persist(pbuf, buf, kPmemFileSize);
+    pmem_memcpy_persist(pbuf, buf, region_size);
+    emul_persist_delay(region_size);
     printf("Hog: iter = %zu, bandwidth = %.2f GB/s\n", iter,
-           (kPmemFileSize * 1.0 / GB(1)) / sec_since(start));
+           (region_size * 1.0 / GB(1)) / sec_since(start));
     iter++;
   }
 }
+
+/**
+ * @brief Read and write \p part sequentially at \p target_GBps until \p stop
+ * is set. A target of zero is unthrottled.
+ *
+ * @param bytes_done The bytes read and written, set on return
+ */
+void bg_thread_func(uint8_t *part, size_t part_size, double target_GBps,
+                    double freq_ghz, const std::atomic<bool> *stop,
+                    size_t *bytes_done) {
+  auto *dram_buf = static_cast<uint8_t *>(malloc(kBgChunkSize));
+  memset(dram_buf, 31, kBgChunkSize);
+
+  const size_t start_tsc = rdtsc();
+  const double cycles_per_byte =
+      target_GBps > 0 ? freq_ghz / target_GBps : 0.0;  // 1 GB/s = 1 byte/ns
+  size_t offset = 0, bytes = 0, bytes_written = 0;
+
+  while (!stop->load(std::memory_order_relaxed)) {
+    // Write when the written fraction is below the target fraction
+    if (bytes_written < FLAGS_bg_write_fraction * (bytes + kBgChunkSize)) {
+      pmem_memcpy_persist(&part[offset], dram_buf, kBgChunkSize);
+      emul_persist_delay(kBgChunkSize);
+      bytes_written += kBgChunkSize;
+    } else {
+      memcpy(dram_buf, &part[offset], kBgChunkSize);
+    }
+    bytes += kBgChunkSize;
+    offset += kBgChunkSize;
+    if (offset + kBgChunkSize > part_size) offset = 0;
+
+    // Wait until the target rate catches up
+    const size_t due_tsc =
+        start_tsc + static_cast<size_t>(bytes * cycles_per_byte);
+    while (rdtsc() < due_tsc && !stop->load(std::memory_order_relaxed)) {
+      _mm_pause();
+    }
+  }
+
+  *bytes_done = bytes;
+  free(dram_buf);
+}
+
+/// Do random reads, then random writes, in \p part, and record each op's
+/// latency in cycles
+void fg_thread_func(uint8_t *part, size_t part_size,
+                    std::vector<size_t> *read_latencies,
+                    std::vector<size_t> *write_latencies) {
+  auto *dram_buf = static_cast<uint8_t *>(malloc(FLAGS_fg_size));
+  memset(dram_buf, 31, FLAGS_fg_size);
+  FastRand fast_rand;
+  const size_t num_slots = part_size / FLAGS_fg_size;
+
+  for (size_t i = 0; i < FLAGS_fg_ops; i++) {
+    const size_t offset = (fast_rand.next_u32() % num_slots) * FLAGS_fg_size;
+    const size_t start_tsc = rdtscp();
+    memcpy(dram_buf, &part[offset], FLAGS_fg_size);
+    memory_barrier();
+    read_latencies->push_back(rdtscp() - start_tsc);
+  }
+
+  for (size_t i = 0; i < FLAGS_fg_ops; i++) {
+    const size_t offset = (fast_rand.next_u32() % num_slots) * FLAGS_fg_size;
+    const size_t start_tsc = rdtscp();
+    pmem_memcpy_persist(&part[offset], dram_buf, FLAGS_fg_size);
+    emul_persist_delay(FLAGS_fg_size);
+    write_latencies->push_back(rdtscp() - start_tsc);
+  }
+
+  free(dram_buf);
+}
+
+struct LatencyPercentiles {
+  double p50_ns;
+  double p99_ns;
+  double p999_ns;
+};
+
+static LatencyPercentiles get_percentiles(std::vector<size_t> &v,
+                                          double freq_ghz) {
+  std::sort(v.begin(), v.end());
+  return {v.at(v.size() / 2) / freq_ghz, v.at(v.size() * 99 / 100) / freq_ghz,
+          v.at(v.size() * 999 / 1000) / freq_ghz};
+}
+
+void interference(uint8_t *pbuf, size_t region_size) {
+  const size_t num_parts = FLAGS_bg_threads + FLAGS_fg_threads;
+  const size_t part_size = region_size / num_parts / KB(4) * KB(4);
+  rt_assert(part_size >= kBgChunkSize, "Region too small for the threads");
+
+  pmem_memset_persist(pbuf, 0, region_size);  // Fault in pages before timing
+  const size_t numa_node = get_region_cpu_node(FLAGS_pmem_file, pbuf);
+  const size_t num_lcores = get_lcores_for_numa_node(numa_node).size();
+  const double freq_ghz = measure_rdtsc_freq();
+  ResultWriter writer(FLAGS_format, FLAGS_output_file);
+  ResultRow metadata;
+  metadata.add("pmem_file", FLAGS_pmem_file);
+  metadata.add("numa_node", numa_node);
+  metadata.add("bg_threads", static_cast<size_t>(FLAGS_bg_threads));
+  metadata.add("bg_write_fraction", FLAGS_bg_write_fraction);
+  metadata.add("fg_threads", static_cast<size_t>(FLAGS_fg_threads));
+  metadata.add("fg_size", static_cast<size_t>(FLAGS_fg_size));
+  writer.write_metadata(metadata);
+
+  // The unloaded p99s, from the first zero-rate run
+  double base_read_p99_ns = 0.0, base_write_p99_ns = 0.0;
+
+  for (const std::string &rate_str : parse_str_list(FLAGS_bg_rates)) {
+    const bool unthrottled = rate_str == "max";
+    const double target_GBps = unthrottled ? 0.0 : std::stod(rate_str);
+    const size_t num_bg = unthrottled || target_GBps > 0 ? FLAGS_bg_threads : 0;
+
+    std::atomic<bool> stop(false);
+    std::vector<size_t> bg_bytes(num_bg);
+    std::vector<std::thread> bg_threads(num_bg);
+    struct timespec start;
+    clock_gettime(CLOCK_REALTIME, &start);
+    for (size_t i = 0; i < num_bg; i++) {
+      bg_threads[i] =
+          std::thread(bg_thread_func, pbuf + i * part_size, part_size,
+                      target_GBps / num_bg, freq_ghz, &stop, &bg_bytes[i]);
+      bind_to_core(bg_threads[i], numa_node, i % num_lcores);
+    }
+
+    std::vector<std::vector<size_t>> read_latencies(FLAGS_fg_threads);
+    std::vector<std::vector<size_t>> write_latencies(FLAGS_fg_threads);
+    std::vector<std::thread> fg_threads(FLAGS_fg_threads);
+    for (size_t i = 0; i < FLAGS_fg_threads; i++) {
+      uint8_t *part = pbuf + (FLAGS_bg_threads + i) * part_size;
+      fg_threads[i] = std::thread(fg_thread_func, part, part_size,
+                                  &read_latencies[i], &write_latencies[i]);
+      bind_to_core(fg_threads[i], numa_node,
+                   (FLAGS_bg_threads + i) % num_lcores);
+    }
+    for (auto &t : fg_threads) t.join();
+
+    stop = true;
+    for (auto &t : bg_threads) t.join();
+    const double bg_GBps =
+        std::accumulate(bg_bytes.begin(), bg_bytes.end(), 0ul) /
+        ns_since(start);
+
+    std::vector<size_t> all_reads, all_writes;
+    for (size_t i = 0; i < FLAGS_fg_threads; i++) {
+      all_reads.insert(all_reads.end(), read_latencies[i].begin(),
+                       read_latencies[i].end());
+      all_writes.insert(all_writes.end(), write_latencies[i].begin(),
+                        write_latencies[i].end());
+    }
+    const LatencyPercentiles reads = get_percentiles(all_reads, freq_ghz);
+    const LatencyPercentiles writes = get_percentiles(all_writes, freq_ghz);
+    if (num_bg == 0 && base_read_p99_ns == 0.0) {
+      base_read_p99_ns = reads.p99_ns;
+      base_write_p99_ns = writes.p99_ns;
+    }
+
+    for (size_t is_write = 0; is_write <= 1; is_write++) {
+      const LatencyPercentiles &p = is_write ? writes : reads;
+      const double base_p99_ns =
+          is_write ? base_write_p99_ns : base_read_p99_ns;
+
+      ResultRow row;
+      row.add("bg_target", rate_str).add("bg_GBps", bg_GBps);
+      row.add("fg_op", is_write ? "write" : "read");
+      row.add("p50_ns", p.p50_ns).add("p99_ns", p.p99_ns);
+      row.add("p999_ns", p.p999_ns);
+      row.add("p99_inflation", base_p99_ns > 0 ? p.p99_ns / base_p99_ns : -1.0);
+      writer.write(row);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (!FLAGS_interference) {
+    rt_assert(getuid() == 0, "You need to be root to run this benchmark");
+  }
+
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, FLAGS_region_size);
+  if (FLAGS_interference) {
+    interference(region.buf, FLAGS_region_size);
+  } else {
+    hog(region.buf, FLAGS_region_size);
+  }
+
+  unmap_pmem_region(region);
+  exit(0);
+}
@@ -11,6 +11,7 @@
 #include <stdexcept>
 #include <string>
 #include <vector>
+#include "../utils/pmem_region.h"
 #include "huge_alloc.h"
 
 namespace phopscotch {
@@ -246,27 +247,13 @@ class HashMap {
     size_t committed_seq_num;
   };
 
-  // Initialize the persistent buffer for this hash table. This modifies only
-  // mapped_len.
-  uint8_t* map_pbuf(size_t& _mapped_len) const {
-    int is_pmem;
-    uint8_t* pbuf = reinterpret_cast<uint8_t*>(
-        pmem_map_file(pmem_file.c_str(), 0 /* length */, 0 /* flags */, 0666,
-                      &_mapped_len, &is_pmem));
-
-    rt_assert(pbuf != nullptr, "pmem_map_file() failed for " + pmem_file);
-    rt_assert(reinterpret_cast<size_t>(pbuf) % 256 == 0, "pbuf not aligned");
-
-    if (mapped_len - file_offset < reqd_space) {
-      fprintf(stderr,
-              "pmem file too small. %.2f GB required for hash table "
-              "(%zu buckets, bucket size = %zu), but only %.2f GB available\n",
-              reqd_space * 1.0 / (1ull << 30), num_buckets, sizeof(Bucket),
-              mapped_len * 1.0 / (1ull << 30));
-    }
-    rt_assert(is_pmem == 1, "File is not pmem");
-
-    return pbuf + file_offset;
+  // Map the persistent buffer for this hash table. This modifies only region.
+  // pmem_file may name an emulated region, see utils/pmem_region.h.
+  uint8_t* map_pbuf() {
+    region = map_pmem_region(pmem_file, file_offset + reqd_space);
+    rt_assert(reinterpret_cast<size_t>(region.buf) % 256 == 0,
+              "pbuf not aligned");
+    return region.buf + file_offset;
   }
 
   HashMap(std::string pmem_file, size_t file_offset, size_t num_requested_keys)
@@ -281,7 +268,7 @@ class HashMap {
 
     Bucket::hopinfo_t::selftest();
 
-    pbuf = map_pbuf(mapped_len);
+    pbuf = map_pbuf();
 
     // Set the committed seq num, and all redo log entry seq nums to zero.
     redo_log = reinterpret_cast<RedoLog*>(pbuf);
@@ -295,7 +282,7 @@ class HashMap {
   }
 
   ~HashMap() {
-    if (pbuf != nullptr) pmem_unmap(pbuf - file_offset, mapped_len);
+    unmap_pmem_region(region);
   }
 
   // Initialize the contents of both regular and extra buckets
@@ -558,7 +545,7 @@ class HashMap {
   Bucket* buckets = nullptr;
 
   uint8_t* pbuf;      // The pmem buffer for this table
-  size_t mapped_len;  // The length mapped by libpmem
+  PmemRegion region;  // The mapping that contains pbuf
   RedoLog* redo_log;
   size_t cur_sequence_number = 1;
 
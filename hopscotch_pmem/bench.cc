@@ -2,18 +2,28 @@
 #include <condition_variable>
 #include <map>
 #include <mutex>
+#include <sstream>
 #include <pcg/pcg_random.hpp>
 #include "../common.h"
+#include "../utils/open_loop.h"
+#include "../utils/parse_list.h"
 #include "phopscotch.h"
 
 #define table phopscotch
 
-DEFINE_string(pmem_file, "/dev/dax12.0", "Persistent memory file name");
+DEFINE_string(pmem_file, "/dev/dax12.0",
+              "Persistent memory file name, or an emulated region such as "
+              "emul:dram. See utils/pmem_region.h.");
 DEFINE_uint64(table_key_capacity, MB(1), "Number of keys in table per thread");
 DEFINE_uint64(batch_size, table::kMaxBatchSize, "Batch size");
 DEFINE_string(benchmark, "get", "Benchmark to run");
 DEFINE_uint64(num_threads, 1, "Number of threads");
 DEFINE_uint64(sweep_optimizations, 0, "Sweep optimizations");
+DEFINE_string(open_loop_rates, "",
+              "Comma-separated offered loads in M ops/s per thread. Each is "
+              "run open-loop. Empty runs closed-loop.");
+DEFINE_string(arrival, "poisson",
+              "Arrival process for open-loop runs: poisson or constant");
 
 //
 // Overhead to occupancy map:
@@ -59,6 +69,7 @@ class Barrier {
   }
 };
 Barrier *barrier;
+double freq_ghz;
 
 /// Given a random number \p rand, return a random number
 static inline uint64_t fastrange64(uint64_t rand, uint64_t n) {
@@ -125,6 +136,22 @@ size_t populate(HashMap *hashmap, size_t thread_id) {
 }
 
 enum class Workload { kGets, kSets, k5050 };
+
+/// Generate a random request for a key in this thread's partition
+static inline void gen_request(pcg64_fast &pcg, size_t max_key,
+                               Workload workload, size_t thread_id,
+                               bool &is_set, Key &key, Value &val) {
+  switch (workload) {
+    case Workload::kGets: is_set = false; break;
+    case Workload::kSets: is_set = true; break;
+    case Workload::k5050: is_set = pcg() % 2 == 0; break;
+  }
+
+  size_t offset_in_partition = 1 + fastrange64(pcg(), max_key - 1);
+  key.key_frag[0] = gen_key(offset_in_partition, thread_id);
+  val.val_frag[0] = is_set ? key.key_frag[0] : 0;
+}
+
 double batch_exp(HashMap *hashmap, size_t max_key, size_t batch_size,
                  Workload workload, size_t thread_id) {
   pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
@@ -147,16 +174,8 @@ double batch_exp(HashMap *hashmap, size_t max_key, size_t batch_size,
   size_t num_success = 0;
   for (size_t i = 1; i <= kNumIters; i += batch_size) {
     for (size_t j = 0; j < batch_size; j++) {
-      switch (workload) {
-        case Workload::kGets: is_set_arr[j] = false; break;
-        case Workload::kSets: is_set_arr[j] = true; break;
-        case Workload::k5050: is_set_arr[j] = pcg() % 2 == 0; break;
-      }
-
-      size_t offset_in_partition = 1 + fastrange64(pcg(), max_key - 1);
-
-      key_arr[j].key_frag[0] = gen_key(offset_in_partition, thread_id);
-      val_arr[j].val_frag[0] = is_set_arr[j] ? key_arr[j].key_frag[0] : 0;
+      gen_request(pcg, max_key, workload, thread_id, is_set_arr[j], key_arr[j],
+                  val_arr[j]);
     }
 
     hashmap->batch_op_drain(is_set_arr, const_cast<const Key **>(key_ptr_arr),
@@ -176,6 +195,64 @@ double batch_exp(HashMap *hashmap, size_t max_key, size_t batch_size,
   return tput;
 }
 
+/// Offer requests at \p rate_mops. Requests that have arrived are executed
+/// in batches of up to batch_size, and each request's latency is measured from
+/// its arrival.
+OpenLoopResult open_loop_exp(HashMap *hashmap, size_t max_key,
+                             size_t batch_size, Workload workload,
+                             size_t thread_id, double rate_mops) {
+  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+  const size_t num_ops =
+      std::min(MB(1), static_cast<size_t>(rate_mops * 1000000));
+
+  bool is_set_arr[table::kMaxBatchSize];
+  Key key_arr[table::kMaxBatchSize];
+  Value val_arr[table::kMaxBatchSize];
+  Key *key_ptr_arr[table::kMaxBatchSize];
+  Value *val_ptr_arr[table::kMaxBatchSize];
+  bool success_arr[table::kMaxBatchSize];
+  size_t arrival_tsc_arr[table::kMaxBatchSize];
+
+  for (size_t i = 0; i < table::kMaxBatchSize; i++) {
+    key_ptr_arr[i] = &key_arr[i];
+    val_ptr_arr[i] = &val_arr[i];
+  }
+
+  std::vector<size_t> latency_vec;
+  latency_vec.reserve(num_ops);
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  ArrivalGenerator arrivals(ArrivalGenerator::parse_type(FLAGS_arrival),
+                            rate_mops, freq_ghz, rdtsc());
+
+  for (size_t i = 0; i < num_ops;) {
+    while (rdtsc() < arrivals.peek()) {
+      // Wait for the next request
+    }
+
+    const size_t now = rdtsc();
+    size_t n = 0;
+    while (n < batch_size && i + n < num_ops && arrivals.peek() <= now) {
+      arrival_tsc_arr[n] = arrivals.next();
+      gen_request(pcg, max_key, workload, thread_id, is_set_arr[n], key_arr[n],
+                  val_arr[n]);
+      n++;
+    }
+
+    hashmap->batch_op_drain(is_set_arr, const_cast<const Key **>(key_ptr_arr),
+                            val_ptr_arr, success_arr, n);
+
+    const size_t end_tsc = rdtsc();
+    for (size_t j = 0; j < n; j++) {
+      latency_vec.push_back(end_tsc - arrival_tsc_arr[j]);
+    }
+    i += n;
+  }
+
+  return summarize_open_loop(latency_vec, rate_mops, ns_since(start),
+                             freq_ghz);
+}
+
 void thread_func(size_t thread_id) {
   size_t bytes_per_map = HashMap::get_required_bytes(FLAGS_table_key_capacity);
   bytes_per_map = roundup<256>(bytes_per_map);
@@ -200,6 +277,21 @@ void thread_func(size_t thread_id) {
   barrier->wait();
   printf("thread %zu, starting work.\n", thread_id);
 
+  if (!FLAGS_open_loop_rates.empty()) {
+    for (double rate : parse_double_list(FLAGS_open_loop_rates)) {
+      const OpenLoopResult r = open_loop_exp(
+          hashmap, max_key, FLAGS_batch_size, workload, thread_id, rate);
+      printf(
+          "thread %zu, offered %.2f M/s: achieved %.2f M/s, latency (ns) = "
+          "%.0f avg, %.0f p50, %.0f p99, %.0f p999\n",
+          thread_id, r.offered_mops, r.achieved_mops, r.avg_ns, r.p50_ns,
+          r.p99_ns, r.p999_ns);
+    }
+
+    delete hashmap;
+    return;
+  }
+
   for (size_t i = 0; i < 10; i++) {
     double tput =
         batch_exp(hashmap, max_key, FLAGS_batch_size, workload, thread_id);
@@ -297,6 +389,7 @@ void sweep_optimizations() {
 
 int main(int argc, char **argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
+  freq_ghz = measure_rdtsc_freq();
 
   if (FLAGS_sweep_optimizations == 1) {
     std::thread t = std::thread(sweep_optimizations);
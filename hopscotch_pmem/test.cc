@@ -4,7 +4,7 @@
 #include "phopscotch.h"
 
 static constexpr size_t kDefaultFileOffset = 1024;
-static constexpr const char *kPmemFile = "/mnt/pmem12/raft_log";
+static const std::string kPmemFile = get_test_pmem_spec();
 
 TEST(Basic, Simple) {
   size_t num_keys = 32;
@@ -0,0 +1,83 @@
+/**
+ * @file async_bench.h
+ * @brief Compare caller-visible append latency and total bandwidth of
+ * synchronous Log appends and asynchronous AsyncLog appends
+ */
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "../common.h"
+#include "../utils/timer.h"
+#include "async_log.h"
+#include "log.h"
+
+static constexpr size_t kAsyncNumIters = 200000;  // Per size and variant
+
+// Print the median and 99.9th percentile of \p latency_vec in ns, and the
+// bandwidth for kAsyncNumIters appends of \p write_sz bytes
+void async_bench_report(std::vector<size_t> &latency_vec, size_t write_sz,
+                        double bench_seconds, double freq_ghz) {
+  std::sort(latency_vec.begin(), latency_vec.end());
+  printf("%.1f %.1f %.2f ", latency_vec.at(kAsyncNumIters * .50) / freq_ghz,
+         latency_vec.at(kAsyncNumIters * .999) / freq_ghz,
+         kAsyncNumIters * write_sz / (bench_seconds * GB(1)));
+}
+
+void async_bench(uint8_t *pbuf, size_t pbuf_size) {
+  double freq_ghz = measure_rdtsc_freq();
+  uint8_t source[kMaxLogDataSize] = {0};
+  std::vector<size_t> latency_vec;
+  latency_vec.reserve(kAsyncNumIters);
+
+  printf(
+      "write_bytes sync_50_ns sync_999_ns sync_GBps "
+      "async_50_ns async_999_ns async_GBps avg_batch\n");
+  for (size_t write_sz = 64; write_sz <= kMaxLogDataSize; write_sz *= 2) {
+    printf("%zu ", write_sz);
+
+    {
+      Log log(pbuf, pbuf_size, true /* create_new */);
+      latency_vec.clear();
+      struct timespec bench_start;
+      clock_gettime(CLOCK_REALTIME, &bench_start);
+
+      for (size_t i = 0; i < kAsyncNumIters; i++) {
+        for (size_t j = 0; j < write_sz; j += 64) source[j]++;
+
+        size_t start_tsc = timer::Start();
+        size_t index = log.append(source, write_sz);
+        latency_vec.push_back(timer::Stop() - start_tsc);
+        rt_assert(index != Log::kInvalidIndex, "Async bench: log full");
+      }
+
+      async_bench_report(latency_vec, write_sz, sec_since(bench_start),
+                         freq_ghz);
+    }
+
+    {
+      AsyncLog log(pbuf, pbuf_size, true /* create_new */);
+      latency_vec.clear();
+      struct timespec bench_start;
+      clock_gettime(CLOCK_REALTIME, &bench_start);
+
+      size_t index = Log::kInvalidIndex;
+      for (size_t i = 0; i < kAsyncNumIters; i++) {
+        for (size_t j = 0; j < write_sz; j += 64) source[j]++;
+
+        size_t start_tsc = timer::Start();
+        index = log.append(source, write_sz);
+        latency_vec.push_back(timer::Stop() - start_tsc);
+        rt_assert(index != Log::kInvalidIndex, "Async bench: log full");
+      }
+
+      // Bandwidth includes the time to make all entries durable
+      log.wait_durable(index);
+      async_bench_report(latency_vec, write_sz, sec_since(bench_start),
+                         freq_ghz);
+      printf("%.1f\n", kAsyncNumIters * 1.0 / log.get_num_batches());
+    }
+  }
+}
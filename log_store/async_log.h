@@ -0,0 +1,239 @@
+/**
+ * @file async_log.h
+ * @brief A persistent log with asynchronous appends. It uses the same pmem
+ * format as Log, so an AsyncLog can be reopened as a Log for reads.
+ * Header-only.
+ */
+#pragma once
+
+#include <malloc.h>
+#include <atomic>
+#include <thread>
+#include "log.h"
+
+/**
+ * Appends copy the entry, already in its pmem format, into a DRAM staging ring
+ * and return without waiting for pmem. Byte offset x of the log is staged at
+ * offset x % staging_size of the ring.
+ *
+ * A persister thread copies staged bytes to pmem in large batches, persists
+ * the tail counter once per batch, and then advances the durable watermark.
+ * Callers poll the watermark with get_durable_index(), block with
+ * wait_durable(), or register a callback that the persister invokes after
+ * each batch.
+ *
+ * Only one thread may append. The destructor persists all staged entries.
+ */
+class AsyncLog {
+ public:
+  static constexpr size_t kDefaultStagingSize = MB(16);
+
+  /// Invoked by the persister thread after entries up to \p durable_index
+  /// become durable
+  typedef void (*durable_callback_t)(size_t durable_index, void *context);
+
+  /**
+   * @brief Construct an asynchronous log and start its persister thread
+   *
+   * @param pbuf The start address of the log on persistent memory
+   *
+   * @param pbuf_size The bytes available at pbuf, including metadata
+   *
+   * @param create_new If true, an empty log is created. If false, appends
+   * continue after the prior pmem contents.
+   *
+   * @param staging_size Bytes in the DRAM staging ring. This must be a
+   * multiple of 64 so that staged and pmem bytes have the same alignment.
+   */
+  AsyncLog(uint8_t *pbuf, size_t pbuf_size, bool create_new,
+           size_t staging_size = kDefaultStagingSize)
+      : log_base_addr(pbuf + Log::get_metadata_space()),
+        staging_size(staging_size) {
+    rt_assert(staging_size % 64 == 0, "AsyncLog: bad staging ring size");
+
+    Log log(pbuf, pbuf_size, create_new);  // Create or recover the log
+    capacity = log.get_capacity();
+    staged_index = log.get_last_index();
+    tail_ctr = Counter(Log::get_tail_ctr_addr(pbuf), false /* create_new */);
+    tail_ctr.v_value = log.get_used_space();  // Includes checksummed entries
+
+    staged_offset = tail_ctr.v_value;
+    v_staged_offset = staged_offset;
+    v_durable_offset = staged_offset;
+    v_durable_index = staged_index;
+
+    staging_buf = reinterpret_cast<uint8_t *>(memalign(4096, staging_size));
+    rt_assert(staging_buf != nullptr, "AsyncLog: staging ring alloc failed");
+    persister = std::thread(&AsyncLog::persister_func, this);
+  }
+
+  ~AsyncLog() {
+    stop.store(true, std::memory_order_release);
+    persister.join();
+    free(staging_buf);
+  }
+
+  /**
+   * @brief Register \p callback to be invoked by the persister thread after
+   * each batch of entries becomes durable. This must be called before the
+   * first append.
+   */
+  void set_durable_callback(durable_callback_t callback, void *context) {
+    callback_context = context;
+    durable_callback.store(callback, std::memory_order_release);
+  }
+
+  /**
+   * @brief Stage an entry for persistence. This waits only if the staging
+   * ring is full.
+   *
+   * @return The index of the new entry, which becomes durable when the
+   * durable watermark reaches it, or Log::kInvalidIndex if the log is full
+   */
+  size_t append(const uint8_t *data, size_t data_size) {
+    assert(data_size <= UINT32_MAX);
+    const size_t entry_space = Log::get_entry_space(data_size);
+    rt_assert(entry_space <= staging_size, "AsyncLog: entry too large");
+    if (unlikely(staged_offset + entry_space > capacity)) {
+      return Log::kInvalidIndex;
+    }
+
+    // Wait for the persister to free ring space
+    while (staged_offset + entry_space -
+               v_durable_offset.load(std::memory_order_acquire) >
+           staging_size) {
+      __builtin_ia32_pause();
+    }
+
+    Log::EntryHeader hdr;
+    hdr.index = staged_index + 1;
+    hdr.data_size = static_cast<uint32_t>(data_size);
+    hdr.checksum = 0;  // The tail counter covers this entry
+
+    copy_to_staging(staged_offset, &hdr, sizeof(hdr));
+    copy_to_staging(staged_offset + sizeof(hdr), data, data_size);
+
+    staged_index = hdr.index;
+    staged_offset += entry_space;
+    v_staged_offset.store(staged_offset, std::memory_order_release);
+    return hdr.index;
+  }
+
+  /// Return the index of the last durable entry
+  size_t get_durable_index() const {
+    return v_durable_index.load(std::memory_order_acquire);
+  }
+
+  /// Wait until the entry at \p index is durable
+  void wait_durable(size_t index) const {
+    while (get_durable_index() < index) __builtin_ia32_pause();
+  }
+
+  /// Return the index of the last staged entry
+  size_t get_last_index() const { return staged_index; }
+
+  /// Return the number of tail counter updates, i.e., persister batches
+  size_t get_num_batches() const {
+    return num_batches.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /// Copy \p len bytes to the staging ring at log offset \p offset
+  void copy_to_staging(size_t offset, const void *src, size_t len) {
+    const size_t ring_offset = offset % staging_size;
+    const size_t first_len = std::min(len, staging_size - ring_offset);
+    auto *src_u8 = reinterpret_cast<const uint8_t *>(src);
+
+    memcpy(staging_buf + ring_offset, src_u8, first_len);
+    if (first_len < len) {
+      memcpy(staging_buf, src_u8 + first_len, len - first_len);
+    }
+  }
+
+  /// Copy \p len bytes from the staging ring at log offset \p offset
+  void copy_from_staging(size_t offset, void *dst, size_t len) const {
+    const size_t ring_offset = offset % staging_size;
+    const size_t first_len = std::min(len, staging_size - ring_offset);
+    auto *dst_u8 = reinterpret_cast<uint8_t *>(dst);
+
+    memcpy(dst_u8, staging_buf + ring_offset, first_len);
+    if (first_len < len) {
+      memcpy(dst_u8 + first_len, staging_buf, len - first_len);
+    }
+  }
+
+  /// Copy the staged log bytes in [start, end) to pmem, without a final fence
+  void persist_range(size_t start, size_t end) {
+    const size_t ring_offset = start % staging_size;
+    const size_t len = end - start;
+    const size_t first_len = std::min(len, staging_size - ring_offset);
+
+    pmem_memcpy_nodrain(log_base_addr + start, staging_buf + ring_offset,
+                        first_len);
+    if (first_len < len) {
+      pmem_memcpy_nodrain(log_base_addr + start + first_len, staging_buf,
+                          len - first_len);
+    }
+  }
+
+  void persister_func() {
+    size_t durable_offset = v_durable_offset.load();
+    size_t durable_index = v_durable_index.load();
+
+    while (true) {
+      // Check stop before loading the staged offset, so that we don't exit
+      // while entries staged before the stop are not durable
+      const bool stopping = stop.load(std::memory_order_acquire);
+      const size_t staged = v_staged_offset.load(std::memory_order_acquire);
+      if (staged == durable_offset) {
+        if (stopping) return;
+        __builtin_ia32_pause();
+        continue;
+      }
+
+      persist_range(durable_offset, staged);
+      pmem_drain();
+      emul_persist_delay(staged - durable_offset);
+      tail_ctr.increment_rotate(staged - durable_offset);
+
+      // Count the batch's entries by walking their headers in DRAM
+      for (size_t offset = durable_offset; offset < staged;) {
+        Log::EntryHeader hdr;
+        copy_from_staging(offset, &hdr, sizeof(hdr));
+        offset += Log::get_entry_space(hdr.data_size);
+        durable_index = hdr.index;
+      }
+
+      durable_offset = staged;
+      v_durable_offset.store(durable_offset, std::memory_order_release);
+      v_durable_index.store(durable_index, std::memory_order_release);
+      num_batches.fetch_add(1, std::memory_order_relaxed);
+
+      durable_callback_t callback =
+          durable_callback.load(std::memory_order_acquire);
+      if (callback != nullptr) callback(durable_index, callback_context);
+    }
+  }
+
+  uint8_t *log_base_addr;  // Starting address of log entries on pmem
+  size_t capacity = 0;     // Bytes available for entries
+  const size_t staging_size;
+  uint8_t *staging_buf = nullptr;  // The DRAM staging ring
+
+  // Owned by the appending thread
+  size_t staged_index = 0;   // Index of the last staged entry
+  size_t staged_offset = 0;  // Log offset of the end of the staged entries
+
+  // Owned by the persister thread
+  Counter tail_ctr;
+  std::thread persister;
+
+  std::atomic<durable_callback_t> durable_callback{nullptr};
+  void *callback_context = nullptr;
+
+  alignas(64) std::atomic<size_t> v_staged_offset;   // Published by appends
+  alignas(64) std::atomic<size_t> v_durable_offset;  // Published by persister
+  std::atomic<size_t> v_durable_index;
+  std::atomic<size_t> num_batches{0};
+  alignas(64) std::atomic<bool> stop{false};
+};
@@ -1,19 +1,45 @@
 #include <assert.h>
+#include <gflags/gflags.h>
 #include <libpmem.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <algorithm>
 #include "../common.h"
+#include "async_log.h"
+#include "circular_log.h"
+#include "concurrent_log.h"
+#include "log.h"
 #include "rotating_counter.h"
 
-static constexpr const char *kFileName = "/mnt/pmem12/raft_log";
+DEFINE_string(benchmark, "all",
+              "Benchmark to run: counter, log, raft, multi_writer, checksum, "
+              "async, scan, index, circular, all. circular is not included "
+              "in all.");
+DEFINE_uint64(circular_duration_sec, 3600, "Duration of the circular bench");
+DEFINE_uint64(circular_entry_size, 256, "Entry size for the circular bench");
+DEFINE_string(pmem_file, "/mnt/pmem12/raft_log",
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram. "
+              "See utils/pmem_region.h.");
+DEFINE_uint64(pmem_size, 0,
+              "Bytes to map. Zero maps the whole file. Required for devdax "
+              "and emul:dram.");
+
 static constexpr size_t kNumMeasurements = 2;
 static constexpr size_t kNumIters = 1000000;
 
 // Amount of data appended to the log in on iteration
 static constexpr size_t kMaxLogDataSize = 4096;
 
+#include "async_bench.h"
+#include "checksum_bench.h"
+#include "index_bench.h"
+#include "circular_bench.h"
+#include "multi_writer_bench.h"
+#include "raft_bench.h"
+#include "scan_bench.h"
+
 void counter_only_bench(uint8_t *pbuf) {
   Counter ctr(pbuf, true /* create a new counter */);
 
@@ -40,31 +66,7 @@ void counter_only_bench(uint8_t *pbuf) {
   }
 }
 
-class Log {
- public:
-  // Assume pbuf is large enough to never overflow
-  Log(uint8_t *pbuf) {
-    ctr = Counter(pbuf, true /* create_new */);
-    log_base_addr = pbuf + Counter::get_reqd_space();
-  }
-
-  // Append with naive counter incrementing
-  void append_naive(uint8_t *data, size_t data_size) {
-    pmem_memcpy_persist(log_base_addr + ctr.v_value, data, data_size);
-    ctr.increment_naive(data_size);
-  }
-
-  // Append with rotating counter incrementing
-  void append_rotating(uint8_t *data, size_t data_size) {
-    pmem_memcpy_persist(log_base_addr + ctr.v_value, data, data_size);
-    ctr.increment_rotate(data_size);
-  }
-
-  Counter ctr;
-  uint8_t *log_base_addr = nullptr;  // Starting address of log contents on pmem
-};
-
-void log_bench(uint8_t *pbuf) {
+void log_bench(uint8_t *pbuf, size_t pbuf_size) {
   uint8_t source[kMaxLogDataSize] = {0};
 
   printf("write_bytes naive_GBps rotating_GBps\n");
@@ -75,52 +77,70 @@ void log_bench(uint8_t *pbuf) {
 
     {
       // Naive log
-      Log log(pbuf);
+      Log log(pbuf, pbuf_size, true /* create_new */);
+      const size_t num_appends = std::min(
+          kNumIters, log.get_capacity() / Log::get_entry_space(write_sz));
       struct timespec bench_start;
       clock_gettime(CLOCK_REALTIME, &bench_start);
 
-      for (size_t i = 0; i < kNumIters; i++) {
+      for (size_t i = 0; i < num_appends; i++) {
         // Modify the source
         for (size_t j = 0; j < write_sz / 64; j += 64) source[j]++;
-        log.append_naive(source, write_sz);
+        size_t index = log.append_naive(source, write_sz);
+        rt_assert(index != Log::kInvalidIndex, "Log bench: log full");
       }
 
       double bench_seconds = sec_since(bench_start);
-      naive_GBps = kNumIters * write_sz / (bench_seconds * GB(1));
+      naive_GBps = num_appends * write_sz / (bench_seconds * GB(1));
     }
 
     {
       // Rotating log
-      Log log(pbuf);
+      Log log(pbuf, pbuf_size, true /* create_new */);
+      const size_t num_appends = std::min(
+          kNumIters, log.get_capacity() / Log::get_entry_space(write_sz));
       struct timespec bench_start;
       clock_gettime(CLOCK_REALTIME, &bench_start);
 
-      for (size_t i = 0; i < kNumIters; i++) {
+      for (size_t i = 0; i < num_appends; i++) {
         // Modify the source
         for (size_t j = 0; j < write_sz / 64; j += 64) source[j]++;
-        log.append_rotating(source, write_sz);
+        size_t index = log.append_rotating(source, write_sz);
+        rt_assert(index != Log::kInvalidIndex, "Log bench: log full");
       }
 
       double bench_seconds = sec_since(bench_start);
-      rotating_GBps = kNumIters * write_sz / (bench_seconds * GB(1));
+      rotating_GBps = num_appends * write_sz / (bench_seconds * GB(1));
     }
 
     printf("%zu %.2f %.2f\n", write_sz, naive_GBps, rotating_GBps);
   }
 }
 
-int main() {
-  size_t mapped_len;
-  int is_pmem;
-  uint8_t *pbuf = reinterpret_cast<uint8_t *>(
-      pmem_map_file(kFileName, 0, 0, 0666, &mapped_len, &is_pmem));
-
-  assert(pbuf != nullptr);
-  assert(mapped_len >= Counter::get_reqd_space());
-
-  counter_only_bench(pbuf);
-  for (size_t msr = 0; msr < kNumMeasurements; msr++) log_bench(pbuf);
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, FLAGS_pmem_size);
+  uint8_t *pbuf = region.buf;
+  const size_t mapped_len = region.len;
+  rt_assert(mapped_len >= Log::get_metadata_space(), "pmem region too small");
+  const bool all = FLAGS_benchmark == "all";
+
+  if (all || FLAGS_benchmark == "counter") counter_only_bench(pbuf);
+  if (all || FLAGS_benchmark == "log") {
+    for (size_t msr = 0; msr < kNumMeasurements; msr++) {
+      log_bench(pbuf, mapped_len);
+    }
+  }
+  if (all || FLAGS_benchmark == "raft") raft_bench(pbuf, mapped_len);
+  if (all || FLAGS_benchmark == "multi_writer") {
+    multi_writer_bench(pbuf, mapped_len);
+  }
+  if (all || FLAGS_benchmark == "checksum") checksum_bench(pbuf, mapped_len);
+  if (all || FLAGS_benchmark == "async") async_bench(pbuf, mapped_len);
+  if (all || FLAGS_benchmark == "scan") scan_bench(pbuf, mapped_len);
+  if (all || FLAGS_benchmark == "index") index_bench(pbuf, mapped_len);
+  if (FLAGS_benchmark == "circular") circular_bench(pbuf, mapped_len);
 
-  pmem_unmap(pbuf, mapped_len);
+  unmap_pmem_region(region);
   exit(0);
 }
@@ -0,0 +1,111 @@
+/**
+ * @file checksum_bench.h
+ * @brief Compare counter-free checksummed appends with the two tail counter
+ * variants, and measure the recovery scan of a checksummed log
+ */
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "../common.h"
+#include "../utils/timer.h"
+#include "log.h"
+
+static constexpr size_t kChecksumNumIters = 200000;  // Per size and variant
+
+// Bytes of checksummed entries written before measuring recovery
+static constexpr size_t kChecksumRecoveryBytes = GB(4);
+
+enum class AppendVariant { kNaive, kRotating, kChecksummed };
+
+// Append kChecksumNumIters entries of \p write_sz bytes. Print latency
+// percentiles and bandwidth.
+void checksum_bench_one(uint8_t *pbuf, size_t pbuf_size, size_t write_sz,
+                        AppendVariant variant, double freq_ghz) {
+  uint8_t source[kMaxLogDataSize] = {0};
+  std::vector<size_t> latency_vec;
+  latency_vec.reserve(kChecksumNumIters);
+
+  Log log(pbuf, pbuf_size, true /* create_new */);
+  struct timespec bench_start;
+  clock_gettime(CLOCK_REALTIME, &bench_start);
+
+  for (size_t i = 0; i < kChecksumNumIters; i++) {
+    for (size_t j = 0; j < write_sz; j += 64) source[j]++;
+
+    size_t start_tsc = timer::Start();
+    size_t index = Log::kInvalidIndex;
+    switch (variant) {
+      case AppendVariant::kNaive:
+        index = log.append_naive(source, write_sz);
+        break;
+      case AppendVariant::kRotating:
+        index = log.append_rotating(source, write_sz);
+        break;
+      case AppendVariant::kChecksummed:
+        index = log.append_checksummed(source, write_sz);
+        break;
+    }
+    latency_vec.push_back(timer::Stop() - start_tsc);
+    rt_assert(index != Log::kInvalidIndex, "Checksum bench: log full");
+  }
+
+  double bench_seconds = sec_since(bench_start);
+  std::sort(latency_vec.begin(), latency_vec.end());
+  printf("%.1f %.1f %.2f ",
+         latency_vec.at(kChecksumNumIters * .50) / freq_ghz,
+         latency_vec.at(kChecksumNumIters * .999) / freq_ghz,
+         kChecksumNumIters * write_sz / (bench_seconds * GB(1)));
+}
+
+void checksum_bench(uint8_t *pbuf, size_t pbuf_size) {
+  double freq_ghz = measure_rdtsc_freq();
+
+  printf(
+      "write_bytes naive_50_ns naive_999_ns naive_GBps "
+      "rotating_50_ns rotating_999_ns rotating_GBps "
+      "checksummed_50_ns checksummed_999_ns checksummed_GBps\n");
+  for (size_t write_sz = 64; write_sz <= kMaxLogDataSize; write_sz *= 2) {
+    printf("%zu ", write_sz);
+    checksum_bench_one(pbuf, pbuf_size, write_sz, AppendVariant::kNaive,
+                       freq_ghz);
+    checksum_bench_one(pbuf, pbuf_size, write_sz, AppendVariant::kRotating,
+                       freq_ghz);
+    checksum_bench_one(pbuf, pbuf_size, write_sz, AppendVariant::kChecksummed,
+                       freq_ghz);
+    printf("\n");
+  }
+
+  // Recovery scans the whole log because the tail counter is never updated.
+  // The persistent index is disabled, since it would let recovery skip to the
+  // last indexed entry.
+  printf("entry_bytes log_GB recovery_sec sec_per_GB\n");
+  for (size_t write_sz = 64; write_sz <= kMaxLogDataSize; write_sz *= 4) {
+    uint8_t source[kMaxLogDataSize] = {0};
+    size_t log_bytes = 0;
+    {
+      Log log(pbuf, pbuf_size, true /* create_new */,
+              false /* persist_index */);
+      while (log.get_used_space() < kChecksumRecoveryBytes) {
+        source[log.get_last_index() % write_sz]++;
+        if (log.append_checksummed(source, write_sz) == Log::kInvalidIndex) {
+          break;
+        }
+      }
+      log_bytes = log.get_used_space();
+    }
+
+    struct timespec recovery_start;
+    clock_gettime(CLOCK_REALTIME, &recovery_start);
+    Log log(pbuf, pbuf_size, false /* create_new */,
+            false /* persist_index */);
+    double recovery_sec = sec_since(recovery_start);
+    rt_assert(log.get_used_space() == log_bytes, "Checksum bench: bad scan");
+
+    double log_GB = log_bytes * 1.0 / GB(1);
+    printf("%zu %.2f %.3f %.3f\n", write_sz, log_GB, recovery_sec,
+           recovery_sec / log_GB);
+  }
+}
@@ -0,0 +1,121 @@
+/**
+ * @file circular_bench.h
+ * @brief Sustained producer/consumer throughput of a CircularLog. This is
+ * meant to run for hours to expose media stalls, e.g., from wear leveling.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "../common.h"
+#include "../utils/timer.h"
+#include "circular_log.h"
+
+static constexpr size_t kCircularRingSize = GB(1);
+static constexpr size_t kCircularNumaNode = 0;
+
+// The consumer trims the log after reading this many bytes, to amortize the
+// head counter persist
+static constexpr size_t kCircularTrimBytes = MB(1);
+
+struct CircularBenchStats {
+  std::atomic<size_t> bytes_appended{0};
+  std::atomic<size_t> bytes_consumed{0};
+  std::atomic<size_t> max_append_cycles{0};  // Reset every interval
+  std::atomic<size_t> num_full{0};           // Appends that found no space
+  std::atomic<bool> stop{false};
+};
+
+void circular_producer(CircularLog *log, CircularBenchStats *stats) {
+  uint8_t source[kMaxLogDataSize] = {0};
+  const size_t entry_size = FLAGS_circular_entry_size;
+
+  while (!stats->stop.load(std::memory_order_relaxed)) {
+    source[stats->bytes_appended.load(std::memory_order_relaxed) %
+           entry_size]++;
+
+    size_t start_tsc = timer::Start();
+    size_t lsn = log->append(source, entry_size);
+    size_t cycles = timer::Stop() - start_tsc;
+
+    if (lsn == CircularLog::kInvalidLsn) {
+      stats->num_full.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    stats->bytes_appended.fetch_add(entry_size, std::memory_order_relaxed);
+    if (cycles > stats->max_append_cycles.load(std::memory_order_relaxed)) {
+      stats->max_append_cycles.store(cycles, std::memory_order_relaxed);
+    }
+  }
+}
+
+void circular_consumer(CircularLog *log, CircularBenchStats *stats) {
+  uint8_t dest[kMaxLogDataSize];
+  size_t bytes_since_trim = 0;
+
+  while (!stats->stop.load(std::memory_order_relaxed)) {
+    size_t data_size;
+    if (!log->read_next(dest, &data_size, nullptr)) continue;
+
+    stats->bytes_consumed.fetch_add(data_size, std::memory_order_relaxed);
+    bytes_since_trim += data_size;
+    if (bytes_since_trim >= kCircularTrimBytes) {
+      log->trim(log->get_read_cursor());
+      bytes_since_trim = 0;
+    }
+  }
+}
+
+void circular_bench(uint8_t *pbuf, size_t pbuf_size) {
+  rt_assert(FLAGS_circular_entry_size <= kMaxLogDataSize,
+            "Circular bench: entry too large");
+  double freq_ghz = measure_rdtsc_freq();
+
+  const size_t log_size = std::min(
+      pbuf_size, CircularLog::get_metadata_space() + kCircularRingSize);
+  CircularLog log(pbuf, log_size, true /* create_new */);
+  printf("Circular log: ring %.2f GB, entry size %zu B, %zu seconds\n",
+         log.get_capacity() * 1.0 / GB(1), FLAGS_circular_entry_size,
+         FLAGS_circular_duration_sec);
+
+  CircularBenchStats stats;
+  std::thread producer(circular_producer, &log, &stats);
+  std::thread consumer(circular_consumer, &log, &stats);
+  bind_to_core(producer, kCircularNumaNode, 0);
+  bind_to_core(consumer, kCircularNumaNode, 1);
+
+  printf("seconds producer_GBps consumer_GBps max_append_us num_full\n");
+  size_t prev_appended = 0, prev_consumed = 0;
+  double prev_seconds = 0.0;
+  struct timespec bench_start;
+  clock_gettime(CLOCK_REALTIME, &bench_start);
+
+  for (size_t sec = 1; sec <= FLAGS_circular_duration_sec; sec++) {
+    sleep(1);
+
+    size_t appended = stats.bytes_appended.load();
+    size_t consumed = stats.bytes_consumed.load();
+    size_t max_cycles = stats.max_append_cycles.exchange(0);
+    double seconds = sec_since(bench_start);
+    double interval_GB = (seconds - prev_seconds) * GB(1);
+
+    printf("%.1f %.2f %.2f %.1f %zu\n", seconds,
+           (appended - prev_appended) / interval_GB,
+           (consumed - prev_consumed) / interval_GB,
+           to_usec(max_cycles, freq_ghz), stats.num_full.exchange(0));
+    fflush(stdout);
+
+    prev_appended = appended;
+    prev_consumed = consumed;
+    prev_seconds = seconds;
+  }
+
+  stats.stop = true;
+  producer.join();
+  consumer.join();
+}
@@ -0,0 +1,222 @@
+/**
+ * @file circular_log.h
+ * @brief A bounded persistent ring buffer log, built on the rotating counter.
+ * Header-only.
+ */
+#pragma once
+
+#include <assert.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include "../common.h"
+#include "../utils/pmem_copy.h"
+#include "rotating_counter.h"
+
+/**
+ * Layout on pmem:
+ *  - Superblock
+ *  - Head counter: LSN of the first entry not trimmed by the consumer
+ *  - Tail counter: LSN of the end of the last entry
+ *  - Ring buffer with entries, each an EntryHeader followed by the payload
+ *
+ * An entry's log sequence number (LSN) is the logical byte offset of its
+ * start. LSNs grow forever, and an LSN's ring offset is LSN % capacity. Since
+ * head and tail only grow, the rotating counter's max-based recovery works for
+ * both. Entries, including their headers, may straddle the end of the ring.
+ *
+ * Appends never overwrite entries that haven't been trimmed. This is safe for
+ * one producer thread (append) and one consumer thread (read_next and trim).
+ *
+ * Copier is the pmem copy policy for entries. See utils/pmem_copy.h.
+ * CircularLog uses libpmem.
+ */
+template <typename Copier>
+class BasicCircularLog {
+ public:
+  static constexpr size_t kMagic = 0x636972636c6f6721;  // "circlog!"
+  static constexpr size_t kInvalidLsn = SIZE_MAX;
+
+  struct Superblock {
+    size_t magic;     // kMagic iff the log was created successfully
+    size_t capacity;  // Bytes in the ring buffer
+  };
+
+  struct EntryHeader {
+    size_t data_size;  // Size of the payload following this header
+  };
+
+  /**
+   * @brief Construct a circular log
+   *
+   * @param pbuf The start address of the log on persistent memory
+   *
+   * @param pbuf_size The bytes available at pbuf, including metadata
+   *
+   * @param create_new If true, an empty log is created. If false, the log is
+   * recovered from the prior pmem contents.
+   */
+  BasicCircularLog(uint8_t *pbuf, size_t pbuf_size, bool create_new)
+      : sb(reinterpret_cast<Superblock *>(pbuf)),
+        ring_base_addr(pbuf + get_metadata_space()) {
+    rt_assert(pbuf_size > get_metadata_space(),
+              "CircularLog: pmem buffer too small");
+    uint8_t *head_ctr_addr = pbuf + roundup<256>(sizeof(Superblock));
+    uint8_t *tail_ctr_addr = head_ctr_addr + Counter::get_reqd_space();
+
+    if (create_new) {
+      head_ctr = Counter(head_ctr_addr, true);
+      tail_ctr = Counter(tail_ctr_addr, true);
+
+      // The magic is persisted separately after everything else, so a
+      // partially-created log is detected even over a stale magic
+      Superblock v_sb;
+      v_sb.magic = 0;
+      v_sb.capacity = (pbuf_size - get_metadata_space()) / 8 * 8;
+      Copier::copy_persist(sb, &v_sb, sizeof(v_sb));
+
+      const size_t magic = kMagic;
+      Copier::copy_persist(&sb->magic, &magic, sizeof(magic));
+    } else {
+      rt_assert(sb->magic == kMagic, "CircularLog: no log found on pmem");
+      rt_assert(sb->capacity <= pbuf_size - get_metadata_space(),
+                "CircularLog: pmem buffer smaller than the log's capacity");
+      head_ctr = Counter(head_ctr_addr, false);
+      tail_ctr = Counter(tail_ctr_addr, false);
+      rt_assert(head_ctr.v_value <= tail_ctr.v_value &&
+                    tail_ctr.v_value - head_ctr.v_value <= sb->capacity,
+                "CircularLog: corrupt head or tail");
+    }
+
+    capacity = sb->capacity;
+    v_head = head_ctr.v_value;
+    v_tail = tail_ctr.v_value;
+    read_cursor = head_ctr.v_value;
+  }
+
+  /// The pmem needed for log metadata, before the ring buffer
+  static size_t get_metadata_space() {
+    return roundup<256>(sizeof(Superblock)) + 2 * Counter::get_reqd_space();
+  }
+
+  /// The ring space consumed by an entry with \p data_size bytes of payload
+  static size_t get_entry_space(size_t data_size) {
+    return roundup<8>(sizeof(EntryHeader) + data_size);
+  }
+
+  /**
+   * @brief Append an entry. Only the producer thread may call this.
+   *
+   * @return The LSN of the new entry, or kInvalidLsn if the ring doesn't have
+   * enough free space
+   */
+  size_t append(const uint8_t *data, size_t data_size) {
+    const size_t entry_space = get_entry_space(data_size);
+    const size_t lsn = tail_ctr.v_value;
+    const size_t head = v_head.load(std::memory_order_acquire);
+    if (unlikely(lsn + entry_space - head > capacity)) return kInvalidLsn;
+
+    EntryHeader hdr;
+    hdr.data_size = data_size;
+    copy_to_ring(lsn, &hdr, sizeof(hdr));
+    copy_to_ring(lsn + sizeof(hdr), data, data_size);
+    Copier::drain();
+    emul_persist_delay(entry_space);
+
+    tail_ctr.increment_rotate(entry_space);
+    v_tail.store(tail_ctr.v_value, std::memory_order_release);
+    return lsn;
+  }
+
+  /**
+   * @brief Copy the entry at the read cursor to \p out_data, and advance the
+   * read cursor. Only the consumer thread may call this.
+   *
+   * @param out_lsn If non-null, this is filled with the entry's LSN
+   *
+   * @return True iff an entry was available. The caller must ensure that
+   * out_data has space for the payload.
+   */
+  bool read_next(uint8_t *out_data, size_t *out_data_size, size_t *out_lsn) {
+    if (read_cursor == v_tail.load(std::memory_order_acquire)) return false;
+
+    EntryHeader hdr;
+    copy_from_ring(read_cursor, &hdr, sizeof(hdr));
+    copy_from_ring(read_cursor + sizeof(hdr), out_data, hdr.data_size);
+
+    *out_data_size = hdr.data_size;
+    if (out_lsn != nullptr) *out_lsn = read_cursor;
+    read_cursor += get_entry_space(hdr.data_size);
+    return true;
+  }
+
+  /**
+   * @brief Discard all entries before \p lsn, freeing their space for the
+   * producer. Only the consumer thread may call this.
+   *
+   * @param lsn An entry boundary between the head and the read cursor, e.g.,
+   * the return value of get_read_cursor()
+   */
+  void trim(size_t lsn) {
+    rt_assert(lsn >= head_ctr.v_value && lsn <= read_cursor,
+              "CircularLog: invalid trim LSN");
+    if (lsn == head_ctr.v_value) return;
+
+    head_ctr.increment_rotate(lsn - head_ctr.v_value);
+    v_head.store(lsn, std::memory_order_release);
+  }
+
+  /// Return the LSN of the first untrimmed entry
+  size_t get_head() const { return v_head.load(std::memory_order_acquire); }
+
+  /// Return the LSN of the end of the last entry
+  size_t get_tail() const { return v_tail.load(std::memory_order_acquire); }
+
+  /// Return the LSN of the next entry to read
+  size_t get_read_cursor() const { return read_cursor; }
+
+  size_t get_capacity() const { return capacity; }
+
+ private:
+  /// Copy \p len bytes to the ring at \p lsn, without a final fence
+  void copy_to_ring(size_t lsn, const void *src, size_t len) {
+    const size_t ring_offset = lsn % capacity;
+    const size_t first_len = std::min(len, capacity - ring_offset);
+    auto *src_u8 = reinterpret_cast<const uint8_t *>(src);
+
+    Copier::copy_nodrain(ring_base_addr + ring_offset, src_u8, first_len);
+    if (first_len < len) {
+      Copier::copy_nodrain(ring_base_addr, src_u8 + first_len,
+                           len - first_len);
+    }
+  }
+
+  /// Copy \p len bytes from the ring at \p lsn
+  void copy_from_ring(size_t lsn, void *dst, size_t len) const {
+    const size_t ring_offset = lsn % capacity;
+    const size_t first_len = std::min(len, capacity - ring_offset);
+    auto *dst_u8 = reinterpret_cast<uint8_t *>(dst);
+
+    memcpy(dst_u8, ring_base_addr + ring_offset, first_len);
+    if (first_len < len) {
+      memcpy(dst_u8 + first_len, ring_base_addr, len - first_len);
+    }
+  }
+
+  Superblock *sb;
+  uint8_t *ring_base_addr;  // Starting address of the ring buffer on pmem
+  size_t capacity = 0;      // Bytes in the ring buffer
+
+  Counter head_ctr;  // Owned by the consumer
+  Counter tail_ctr;  // Owned by the producer
+
+  // Persistent head and tail, published for the other thread
+  alignas(64) std::atomic<size_t> v_head;
+  alignas(64) std::atomic<size_t> v_tail;
+
+  alignas(64) size_t read_cursor;  // Owned by the consumer
+};
+
+typedef BasicCircularLog<LibpmemCopy> CircularLog;
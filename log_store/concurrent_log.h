@@ -0,0 +1,177 @@
+/**
+ * @file concurrent_log.h
+ * @brief A persistent log that supports concurrent appends from multiple
+ * threads. It uses the same pmem format as Log, so a ConcurrentLog can be
+ * reopened as a Log for reads. Header-only.
+ */
+#pragma once
+
+#include <atomic>
+#include "log.h"
+
+/**
+ * Appending an entry has three steps:
+ *  1. Reserve an entry number and log space with a CAS on v_tail
+ *  2. Copy and persist the entry. Writers do this in parallel.
+ *  3. Mark the entry as complete in the completion bitmap. Whichever writer
+ *     holds the commit lock advances the commit pointer over all consecutive
+ *     completed entries, and persists the tail counter once for the group.
+ *
+ * An append that doesn't fit in the log fails without reserving anything, so
+ * callers may retry with smaller entries.
+ */
+class ConcurrentLog {
+ public:
+  // Maximum number of reserved but uncommitted entries. Writers wait for the
+  // commit pointer when their entry is this far ahead of it.
+  static constexpr size_t kMaxInflight = 1024;
+  static_assert(kMaxInflight % 64 == 0, "");
+
+  // v_tail packs two fields:
+  //  - Low kOffsetBits bits: byte offset of the end of the reserved space
+  //  - High bits: the number of entries reserved since the log was opened,
+  //    modulo 2^(64 - kOffsetBits). This is the entry's "ticket".
+  static constexpr size_t kOffsetBits = 40;
+  static constexpr size_t kOffsetMask = (1ull << kOffsetBits) - 1;
+  static constexpr size_t kTicketMask = (1ull << (64 - kOffsetBits)) - 1;
+
+  /**
+   * @brief Construct a concurrent log
+   *
+   * @param pbuf The start address of the log on persistent memory
+   *
+   * @param pbuf_size The bytes available at pbuf, including metadata
+   *
+   * @param create_new If true, an empty log is created. If false, appends
+   * continue after the prior pmem contents.
+   */
+  ConcurrentLog(uint8_t *pbuf, size_t pbuf_size, bool create_new)
+      : log_base_addr(pbuf + Log::get_metadata_space()) {
+    Log log(pbuf, pbuf_size, create_new);  // Create or recover the log
+
+    rt_assert(log.get_capacity() <= kOffsetMask,
+              "ConcurrentLog: log too large");
+
+    capacity = log.get_capacity();
+    base_index = log.get_last_index() + 1;
+    tail_ctr = Counter(Log::get_tail_ctr_addr(pbuf), false /* create_new */);
+    tail_ctr.v_value = log.get_used_space();  // Includes checksummed entries
+    v_tail = tail_ctr.v_value;
+
+    for (auto &word : done_bitmap) word = 0;
+  }
+
+  /**
+   * @brief Append an entry. This is thread-safe.
+   *
+   * @return The index of the new entry, or Log::kInvalidIndex if the log is
+   * full. When this returns, the entry and all entries before it are durable.
+   */
+  size_t append(const uint8_t *data, size_t data_size) {
+    const size_t entry_space = Log::get_entry_space(data_size);
+
+    // Reserve only if the entry fits, so the offset never carries into the
+    // ticket bits
+    size_t old_tail = v_tail.load(std::memory_order_relaxed);
+    do {
+      if (unlikely((old_tail & kOffsetMask) + entry_space > capacity)) {
+        return Log::kInvalidIndex;
+      }
+    } while (!v_tail.compare_exchange_weak(
+        old_tail, old_tail + entry_space + (1ull << kOffsetBits),
+        std::memory_order_relaxed));
+    const size_t offset = old_tail & kOffsetMask;
+
+    // Our entry is uncommitted, so it's less than 2^(64 - kOffsetBits) ahead of
+    // the commit pointer. This lets us recover its full sequence number.
+    const size_t ticket = old_tail >> kOffsetBits;
+    const size_t committed = commit_seq.load(std::memory_order_acquire);
+    const size_t seq = committed + ((ticket - committed) & kTicketMask);
+
+    // Wait for our slot in the completion ring to be freed
+    while (seq - commit_seq.load(std::memory_order_acquire) >= kMaxInflight) {
+      __builtin_ia32_pause();
+    }
+
+    Log::EntryHeader hdr;
+    hdr.index = base_index + seq;
+    hdr.data_size = static_cast<uint32_t>(data_size);
+    hdr.checksum = 0;  // The tail counter covers this entry
+
+    uint8_t *entry_addr = log_base_addr + offset;
+    pmem_memcpy_nodrain(entry_addr, &hdr, sizeof(hdr));
+    pmem_memcpy_nodrain(entry_addr + sizeof(hdr), data, data_size);
+    pmem_drain();
+    emul_persist_delay(entry_space);
+
+    const size_t slot = seq % kMaxInflight;
+    end_offset[slot] = offset + entry_space;
+    done_bitmap[slot / 64].fetch_or(1ull << (slot % 64),
+                                    std::memory_order_release);
+
+    while (commit_seq.load(std::memory_order_acquire) <= seq) {
+      try_commit();
+      __builtin_ia32_pause();
+    }
+
+    return hdr.index;
+  }
+
+  /// Return the index of the last durable entry
+  size_t get_last_index() const {
+    return base_index + commit_seq.load(std::memory_order_acquire) - 1;
+  }
+
+  /// Return the bytes available for entries
+  size_t get_capacity() const { return capacity; }
+
+  /// Return the number of tail counter updates, i.e., commit groups
+  size_t get_num_commit_groups() const { return num_commit_groups; }
+
+ private:
+  /// If no other thread is committing, advance the commit pointer over all
+  /// consecutive completed entries and persist the tail counter once
+  void try_commit() {
+    if (commit_lock.test_and_set(std::memory_order_acquire)) return;
+
+    size_t seq = commit_seq.load(std::memory_order_relaxed);
+    size_t new_tail = tail_ctr.v_value;
+    while (true) {
+      const size_t slot = seq % kMaxInflight;
+      std::atomic<uint64_t> &word = done_bitmap[slot / 64];
+      const uint64_t bit = 1ull << (slot % 64);
+      if ((word.load(std::memory_order_acquire) & bit) == 0) break;
+
+      new_tail = end_offset[slot];
+      word.fetch_and(~bit, std::memory_order_relaxed);
+      seq++;
+    }
+
+    if (seq != commit_seq.load(std::memory_order_relaxed)) {
+      tail_ctr.increment_rotate(new_tail - tail_ctr.v_value);
+      num_commit_groups++;
+      commit_seq.store(seq, std::memory_order_release);  // Frees ring slots
+    }
+
+    commit_lock.clear(std::memory_order_release);
+  }
+
+  uint8_t *log_base_addr;  // Starting address of log entries on pmem
+  size_t capacity = 0;     // Bytes available for entries
+  size_t base_index = 0;   // Index of the first entry appended by us
+
+  alignas(64) std::atomic<size_t> v_tail;  // Reservation tail, see above
+
+  // Number of entries committed since the log was opened
+  alignas(64) std::atomic<size_t> commit_seq{0};
+
+  // Protects tail_ctr and num_commit_groups
+  alignas(64) std::atomic_flag commit_lock = ATOMIC_FLAG_INIT;
+  Counter tail_ctr;
+  size_t num_commit_groups = 0;
+
+  // Completion state of in-flight entries, indexed by sequence number modulo
+  // kMaxInflight. end_offset[i] is valid when bit i is set in done_bitmap.
+  alignas(64) std::atomic<uint64_t> done_bitmap[kMaxInflight / 64];
+  size_t end_offset[kMaxInflight];
+};
@@ -0,0 +1,69 @@
+/**
+ * @file index_bench.h
+ * @brief Cost and benefit of the Log's persistent index: append throughput
+ * with and without index maintenance, recovery time, and random get(i)
+ * latency
+ */
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "../common.h"
+#include "../utils/timer.h"
+#include "log.h"
+
+static constexpr size_t kIndexNumReads = 1000000;
+
+void index_bench(uint8_t *pbuf, size_t pbuf_size) {
+  double freq_ghz = measure_rdtsc_freq();
+  uint8_t source[kMaxLogDataSize] = {0};
+  std::vector<size_t> latency_vec;
+  latency_vec.reserve(kIndexNumReads);
+  FastRand fast_rand;
+
+  printf(
+      "entry_bytes persist_index M_appends_per_sec recovery_ms "
+      "recovery_walked get_50_ns get_99_ns\n");
+  for (size_t write_sz = 64; write_sz <= kMaxLogDataSize; write_sz *= 4) {
+    for (size_t persist_index = 0; persist_index <= 1; persist_index++) {
+      double append_mops;
+      {
+        Log log(pbuf, pbuf_size, true /* create_new */, persist_index == 1);
+        const size_t num_appends = std::min(
+            kNumIters, log.get_capacity() / Log::get_entry_space(write_sz));
+        struct timespec bench_start;
+        clock_gettime(CLOCK_REALTIME, &bench_start);
+
+        for (size_t i = 0; i < num_appends; i++) {
+          source[i % write_sz]++;
+          size_t index = log.append(source, write_sz);
+          rt_assert(index != Log::kInvalidIndex, "Index bench: log full");
+        }
+        append_mops = num_appends / (sec_since(bench_start) * 1000000);
+      }
+
+      struct timespec recovery_start;
+      clock_gettime(CLOCK_REALTIME, &recovery_start);
+      // Without the index, recovery must not write slots for the entries it
+      // walks, so that recovery_ms is the cost of a plain scan
+      Log log(pbuf, pbuf_size, false /* create_new */, persist_index == 1);
+      double recovery_ms = sec_since(recovery_start) * 1000;
+
+      latency_vec.clear();
+      for (size_t i = 0; i < kIndexNumReads; i++) {
+        size_t index = 1 + fast_rand.next_u32() % log.get_last_index();
+        size_t start_tsc = timer::Start();
+        log.read(index, source, nullptr);
+        latency_vec.push_back(timer::Stop() - start_tsc);
+      }
+      std::sort(latency_vec.begin(), latency_vec.end());
+
+      printf("%zu %zu %.2f %.2f %zu %.1f %.1f\n", write_sz, persist_index,
+             append_mops, recovery_ms, log.get_num_recovery_walked(),
+             latency_vec.at(kIndexNumReads * .50) / freq_ghz,
+             latency_vec.at(kIndexNumReads * .99) / freq_ghz);
+    }
+  }
+}
@@ -0,0 +1,477 @@
+/**
+ * @file log.h
+ * @brief A persistent append-only log for raft, built on the rotating counter.
+ * Header-only.
+ */
+#pragma once
+
+#include <assert.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "../common.h"
+#include "../utils/crc32c.h"
+#include "../utils/pmem_copy.h"
+#include "rotating_counter.h"
+
+/**
+ * Layout on pmem:
+ *  - Superblock
+ *  - Tail counter: byte offset of the end of the last entry
+ *  - Head counter: byte offset of the first entry not discarded by compaction
+ *  - Entries, each an EntryHeader followed by the payload
+ *  - Persistent index: the offset of every kSparseIndexStride-th entry
+ *
+ * Entry indices start from one, like raft. Index zero means "no entry". The
+ * log is linear: space freed by prefix compaction is not reused.
+ *
+ * Entries appended with append_checksummed() don't update the tail counter.
+ * Instead, each entry's header has a CRC32C over the header and payload,
+ * chained from the previous entry's checksum and seeded by a per-log nonce.
+ * Recovery continues past the counter's tail while entries validate, so such
+ * appends need only one persist. Checksums also cover the log's truncation
+ * count, so entries left beyond the tail by truncate_suffix() never validate
+ * again, even if identical entries are re-appended before them.
+ *
+ * Appends update the persistent index with regular stores, and flush a
+ * cacheline of index slots only when it fills up, so maintaining the index
+ * costs one flush per 8 * kSparseIndexStride appends. Slots that were lost in
+ * a crash are rebuilt by recovery, which walks entry headers only after the
+ * last persistent slot. A slot may persist before the tail counter commits
+ * its entry, so recovery ignores slots at or past the counter's tail.
+ * ConcurrentLog and AsyncLog append in this format but bypass the persistent
+ * index, so recovery walks all the entries they appended, and writes their
+ * slots.
+ *
+ * Copier is the pmem copy policy for entries and metadata. See
+ * utils/pmem_copy.h. Log uses libpmem.
+ */
+template <typename Copier>
+class BasicLog {
+ public:
+  static constexpr size_t kMagic = 0x6c6f6773746f7265;  // "logstore"
+  static constexpr size_t kInvalidIndex = 0;
+
+  // We keep the offset of one in every kSparseIndexStride entries in DRAM and
+  // in the persistent index. Lookups walk at most kSparseIndexStride - 1 entry
+  // headers from there.
+  static constexpr size_t kSparseIndexStride = 64;
+  static constexpr size_t kIndexSlotsPerLine = 64 / sizeof(size_t);
+
+  struct Superblock {
+    size_t magic;            // kMagic iff the log was created successfully
+    size_t capacity;         // Bytes available for entries
+    size_t nonce;            // Random value that seeds the entry checksum chain
+    size_t num_index_slots;  // Slots in the persistent index
+    size_t truncations;      // truncate_suffix() calls, mixed into checksums
+  };
+
+  struct EntryHeader {
+    size_t index;        // Index of this entry
+    uint32_t data_size;  // Size of the payload following this header
+    uint32_t checksum;   // Zero for entries appended with a counter update
+  };
+
+  /**
+   * @brief Construct a log
+   *
+   * @param pbuf The start address of the log on persistent memory
+   *
+   * @param pbuf_size The bytes available at pbuf, including metadata
+   *
+   * @param create_new If true, an empty log is created. If false, the log is
+   * recovered from the prior pmem contents.
+   *
+   * @param persist_index If false, appends and recovery don't update the
+   * persistent index. This is only for measuring the index's cost, and the
+   * cost of a full recovery scan.
+   */
+  BasicLog(uint8_t *pbuf, size_t pbuf_size, bool create_new,
+      bool persist_index = true)
+      : sb(reinterpret_cast<Superblock *>(pbuf)),
+        log_base_addr(pbuf + get_metadata_space()),
+        persist_index(persist_index) {
+    rt_assert(pbuf_size > get_metadata_space(), "Log: pmem buffer too small");
+    uint8_t *tail_ctr_addr = get_tail_ctr_addr(pbuf);
+    uint8_t *head_ctr_addr = tail_ctr_addr + Counter::get_reqd_space();
+
+    if (create_new) {
+      tail_ctr = Counter(tail_ctr_addr, true);
+      head_ctr = Counter(head_ctr_addr, true);
+
+      // The smallest entry is a header, so there is one slot per
+      // kSparseIndexStride * sizeof(EntryHeader) bytes of entries
+      const size_t avail = pbuf_size - get_metadata_space();
+      const size_t num_index_slots =
+          avail / (kSparseIndexStride * sizeof(EntryHeader)) + 1;
+      const size_t index_size = roundup<64>(num_index_slots * sizeof(size_t));
+      rt_assert(avail > index_size, "Log: pmem buffer too small");
+
+      // The magic is persisted separately after everything else, so a
+      // partially-created log is detected even over a stale magic
+      Superblock v_sb;
+      v_sb.magic = 0;
+      v_sb.capacity = (avail - index_size) / 64 * 64;
+      v_sb.nonce = SlowRand().next_u64();
+      v_sb.num_index_slots = num_index_slots;
+      v_sb.truncations = 0;
+      pmem_memset_persist(log_base_addr + v_sb.capacity, 0, index_size);
+      Copier::copy_persist(sb, &v_sb, sizeof(v_sb));
+
+      const size_t magic = kMagic;
+      Copier::copy_persist(&sb->magic, &magic, sizeof(magic));
+    } else {
+      rt_assert(sb->magic == kMagic, "Log: no log found on pmem");
+      rt_assert(sb->capacity + sb->num_index_slots * sizeof(size_t) <=
+                    pbuf_size - get_metadata_space(),
+                "Log: pmem buffer smaller than the log's capacity");
+      tail_ctr = Counter(tail_ctr_addr, false);
+      head_ctr = Counter(head_ctr_addr, false);
+    }
+
+    capacity = sb->capacity;
+    index_slots = reinterpret_cast<size_t *>(log_base_addr + capacity);
+    recover_volatile_state();
+  }
+
+  /// The pmem needed for log metadata, before the first entry
+  static size_t get_metadata_space() {
+    return roundup<256>(sizeof(Superblock)) + 2 * Counter::get_reqd_space();
+  }
+
+  /// Return the address of the tail counter for a log at \p pbuf
+  static uint8_t *get_tail_ctr_addr(uint8_t *pbuf) {
+    return pbuf + roundup<256>(sizeof(Superblock));
+  }
+
+  /// The pmem consumed by an entry with \p data_size bytes of payload
+  static size_t get_entry_space(size_t data_size) {
+    return roundup<8>(sizeof(EntryHeader) + data_size);
+  }
+
+  /// Append with naive tail counter incrementing. Return the new entry's
+  /// index, or kInvalidIndex if the log is full.
+  size_t append_naive(const uint8_t *data, size_t data_size) {
+    size_t index = append_nocommit(data, data_size);
+    if (index != kInvalidIndex) {
+      tail_ctr.increment_naive(get_entry_space(data_size));
+    }
+    return index;
+  }
+
+  /// Append with rotating tail counter incrementing. Return the new entry's
+  /// index, or kInvalidIndex if the log is full.
+  size_t append_rotating(const uint8_t *data, size_t data_size) {
+    size_t index = append_nocommit(data, data_size);
+    if (index != kInvalidIndex) {
+      tail_ctr.increment_rotate(get_entry_space(data_size));
+    }
+    return index;
+  }
+
+  /// Append without updating the tail counter. The entry carries a checksum
+  /// that recovery uses to find it. Return the new entry's index, or
+  /// kInvalidIndex if the log is full.
+  size_t append_checksummed(const uint8_t *data, size_t data_size) {
+    size_t index = append_nocommit(data, data_size, true /* checksum */);
+    if (index != kInvalidIndex) tail_ctr.v_value += get_entry_space(data_size);
+    return index;
+  }
+
+  inline size_t append(const uint8_t *data, size_t data_size) {
+    return append_rotating(data, data_size);
+  }
+
+  /**
+   * @brief Copy the payload of the entry at \p index to \p out_data
+   *
+   * @param out_data_size If non-null, this is filled with the payload size
+   *
+   * @return True iff the entry exists. The caller must ensure that out_data
+   * has space for the payload.
+   */
+  bool read(size_t index, uint8_t *out_data, size_t *out_data_size) const {
+    if (index < first_index || index > last_index) return false;
+
+    auto *hdr = get_header(offset_of(index));
+    memcpy(out_data, reinterpret_cast<const uint8_t *>(hdr + 1),
+           hdr->data_size);
+    if (out_data_size != nullptr) *out_data_size = hdr->data_size;
+    return true;
+  }
+
+  /// Return the payload size of the entry at \p index, or 0 if it does not
+  /// exist
+  size_t get_data_size(size_t index) const {
+    if (index < first_index || index > last_index) return 0;
+    return get_header(offset_of(index))->data_size;
+  }
+
+  /**
+   * @brief Delete all entries with index >= \p index, e.g., when a raft
+   * follower's log conflicts with the leader's
+   *
+   * Entries discarded by compaction cannot be truncated.
+   */
+  void truncate_suffix(size_t index) {
+    rt_assert(index >= first_index, "Log: truncating compacted entries");
+    if (index > last_index) return;
+
+    const size_t new_tail = offset_of(index);
+
+    // Clear persistent index slots of truncated entries before they can be
+    // overwritten. Slot i is for entry (i * kSparseIndexStride + 1).
+    const size_t first_slot =
+        (index + kSparseIndexStride - 2) / kSparseIndexStride;
+    const size_t num_slots = sparse_offsets.size();
+    if (first_slot < num_slots) {
+      pmem_memset_persist(&index_slots[first_slot], 0,
+                          (num_slots - first_slot) * sizeof(size_t));
+    }
+
+    // Commit the kept entries with the counter, then invalidate the checksums
+    // of all entries beyond it. Truncation takes effect when the count is
+    // persistent.
+    tail_ctr.set_value(new_tail);
+    const size_t truncations = sb->truncations + 1;
+    Copier::copy_persist(&sb->truncations, &truncations, sizeof(truncations));
+
+    last_index = index - 1;
+    prev_checksum = get_checksum_seed(index);
+    sparse_offsets.resize(
+        (last_index + kSparseIndexStride - 1) / kSparseIndexStride);
+  }
+
+  /**
+   * @brief Discard all entries with index < \p index, e.g., after a raft
+   * snapshot. Discarded entries cannot be read after this returns.
+   */
+  void compact_prefix(size_t index) {
+    rt_assert(index <= last_index + 1, "Log: compacting past the tail");
+    if (index <= first_index) return;
+
+    size_t new_head =
+        index == last_index + 1 ? tail_ctr.v_value : offset_of(index);
+    head_ctr.increment_rotate(new_head - head_ctr.v_value);
+    first_index = index;
+  }
+
+  /// Return the index of the first entry, or last_index + 1 if empty
+  size_t get_first_index() const { return first_index; }
+
+  /// Return the index of the last entry, or first_index - 1 if empty
+  size_t get_last_index() const { return last_index; }
+
+  /// Return the number of entries in the log
+  size_t get_num_entries() const { return last_index + 1 - first_index; }
+
+  /// Return the pmem bytes consumed by entries, including compacted ones
+  size_t get_used_space() const { return tail_ctr.v_value; }
+
+  /// Return the number of entries whose headers recovery walked, i.e., those
+  /// after the last persistent index slot
+  size_t get_num_recovery_walked() const { return num_recovery_walked; }
+
+  size_t get_capacity() const { return capacity; }
+
+ private:
+  template <typename>
+  friend class BasicLogIterator;
+
+  /// Persist an entry at the tail without updating the tail counter
+  size_t append_nocommit(const uint8_t *data, size_t data_size,
+                         bool checksum = false) {
+    assert(data_size <= UINT32_MAX);
+    const size_t entry_space = get_entry_space(data_size);
+    const size_t offset = tail_ctr.v_value;
+    if (unlikely(offset + entry_space > capacity)) return kInvalidIndex;
+
+    const size_t index = last_index + 1;
+    EntryHeader hdr;
+    hdr.index = index;
+    hdr.data_size = static_cast<uint32_t>(data_size);
+    hdr.checksum = checksum ? compute_checksum(prev_checksum, &hdr, data) : 0;
+    prev_checksum = hdr.checksum;
+
+    uint8_t *entry_addr = log_base_addr + offset;
+    Copier::copy_nodrain(entry_addr, &hdr, sizeof(hdr));
+    Copier::copy_nodrain(entry_addr + sizeof(hdr), data, data_size);
+    Copier::drain();
+    emul_persist_delay(entry_space);
+
+    if ((index - 1) % kSparseIndexStride == 0) add_index_slot(offset);
+    last_index = index;
+    return index;
+  }
+
+  /// Record \p offset as the offset of the next sparsely-indexed entry
+  void add_index_slot(size_t offset) {
+    const size_t slot = sparse_offsets.size();
+    sparse_offsets.push_back(offset);
+    if (!persist_index) return;
+
+    // Zero means an empty slot, so we store offset + 1. The entry is already
+    // persistent. The next append's drain orders the flush.
+    rt_assert(slot < sb->num_index_slots, "Log: persistent index full");
+    index_slots[slot] = offset + 1;
+    if (slot % kIndexSlotsPerLine == kIndexSlotsPerLine - 1) {
+      pmem_flush(&index_slots[slot], sizeof(size_t));
+    }
+  }
+
+  /// Return the checksum of an entry with header \p hdr and payload \p data,
+  /// chained from the previous entry's checksum \p seed
+  uint32_t compute_checksum(uint32_t seed, const EntryHeader *hdr,
+                            const uint8_t *data) const {
+    uint32_t crc = crc32c(seed, &sb->truncations, sizeof(sb->truncations));
+    crc = crc32c(crc, &hdr->index, sizeof(hdr->index));
+    crc = crc32c(crc, &hdr->data_size, sizeof(hdr->data_size));
+    return crc32c(crc, data, hdr->data_size);
+  }
+
+  /// Return the checksum chain seed for the entry at \p index
+  uint32_t get_checksum_seed(size_t index) const {
+    if (index == 1) return static_cast<uint32_t>(sb->nonce);
+    return get_header(offset_of(index - 1))->checksum;
+  }
+
+  inline const EntryHeader *get_header(size_t offset) const {
+    return reinterpret_cast<const EntryHeader *>(log_base_addr + offset);
+  }
+
+  /// Return the byte offset of an existing entry
+  size_t offset_of(size_t index) const {
+    size_t offset = sparse_offsets[(index - 1) / kSparseIndexStride];
+    for (size_t i = 0; i < (index - 1) % kSparseIndexStride; i++) {
+      offset += get_entry_space(get_header(offset)->data_size);
+    }
+    return offset;
+  }
+
+  /// Return true if the bytes at \p offset are a valid checksummed entry with
+  /// index \p index, chained from checksum \p seed
+  bool is_valid_entry(size_t offset, size_t index, uint32_t seed) const {
+    if (offset + sizeof(EntryHeader) > capacity) return false;
+    const EntryHeader *hdr = get_header(offset);
+    if (hdr->index != index) return false;
+    if (offset + get_entry_space(hdr->data_size) > capacity) return false;
+
+    auto *data = reinterpret_cast<const uint8_t *>(hdr + 1);
+    return compute_checksum(seed, hdr, data) == hdr->checksum;
+  }
+
+  /// Return the index of the entry at byte offset \p offset, which must be an
+  /// entry boundary or the tail
+  size_t index_at_offset(size_t offset) const {
+    if (offset == tail_ctr.v_value) return last_index + 1;
+
+    auto it = std::upper_bound(sparse_offsets.begin(), sparse_offsets.end(),
+                               offset);
+    rt_assert(it != sparse_offsets.begin(), "Log: offset before first entry");
+    size_t slot = static_cast<size_t>(it - sparse_offsets.begin()) - 1;
+
+    size_t index = slot * kSparseIndexStride + 1;
+    size_t cur_offset = sparse_offsets[slot];
+    while (cur_offset < offset) {
+      cur_offset += get_entry_space(get_header(cur_offset)->data_size);
+      index++;
+    }
+    rt_assert(cur_offset == offset, "Log: offset is not at an entry boundary");
+    return index;
+  }
+
+  /// Rebuild the DRAM state from the persistent index, and by walking entry
+  /// headers after the last persistent slot before the counter's tail up to
+  /// that tail, and then past it while entries validate
+  void recover_volatile_state() {
+    const size_t head = head_ctr.v_value;
+    const size_t ctr_tail = tail_ctr.v_value;
+    rt_assert(ctr_tail <= capacity, "Log: corrupt tail");
+
+    // A slot is written before the tail counter commits its entry, so only
+    // slots of entries before the counter's tail are trusted. Later entries,
+    // including checksummed ones, must validate in the walk below.
+    sparse_offsets.clear();
+    size_t num_slots = 0;
+    while (num_slots < sb->num_index_slots && index_slots[num_slots] != 0) {
+      const size_t offset = index_slots[num_slots] - 1;
+      if (offset >= ctr_tail) break;
+      rt_assert(get_header(offset)->index == num_slots * kSparseIndexStride + 1,
+                "Log: corrupt persistent index");
+      sparse_offsets.push_back(offset);
+      num_slots++;
+    }
+
+    // Start walking from the last indexed entry, which is re-added by the walk
+    size_t offset = 0;
+    size_t index = 1;
+    uint32_t checksum = static_cast<uint32_t>(sb->nonce);
+    if (num_slots > 0) {
+      offset = sparse_offsets.back();
+      index = (num_slots - 1) * kSparseIndexStride + 1;
+      sparse_offsets.pop_back();
+    }
+
+    num_recovery_walked = 0;
+    while (true) {
+      const EntryHeader *hdr = get_header(offset);
+      if (offset < ctr_tail) {
+        rt_assert(hdr->index == index, "Log: corrupt entry header");
+      } else if (!is_valid_entry(offset, index, checksum)) {
+        break;
+      }
+
+      if ((index - 1) % kSparseIndexStride == 0) add_index_slot(offset);
+
+      if (offset < ctr_tail) {
+        rt_assert(offset + get_entry_space(hdr->data_size) <= ctr_tail,
+                  "Log: tail is not at an entry boundary");
+      }
+
+      checksum = hdr->checksum;
+      offset += get_entry_space(hdr->data_size);
+      index++;
+      num_recovery_walked++;
+    }
+
+    // Clear the slots of entries that didn't survive, so that they aren't
+    // mistaken for slots of later entries at other offsets
+    if (persist_index) {
+      const size_t first_stale = sparse_offsets.size();
+      size_t end = first_stale;
+      while (end < sb->num_index_slots && index_slots[end] != 0) end++;
+      if (end > first_stale) {
+        pmem_memset_persist(&index_slots[first_stale], 0,
+                            (end - first_stale) * sizeof(size_t));
+      }
+    }
+
+    rt_assert(head <= offset, "Log: corrupt head");
+    tail_ctr.v_value = offset;  // Includes checksummed entries
+    last_index = index - 1;
+    prev_checksum = checksum;
+    first_index = index_at_offset(head);
+  }
+
+  Superblock *sb;
+  uint8_t *log_base_addr;  // Starting address of log entries on pmem
+  size_t capacity = 0;     // Bytes available for entries
+  size_t *index_slots;     // The persistent index, after the entries
+  const bool persist_index;
+  size_t num_recovery_walked = 0;
+
+  Counter tail_ctr;  // Byte offset of the end of the log
+  Counter head_ctr;  // Byte offset of the first non-compacted entry
+
+  size_t first_index = 1;
+  size_t last_index = 0;
+  uint32_t prev_checksum = 0;  // Checksum of the last entry, or the seed
+
+  // sparse_offsets[i] is the byte offset of entry (i * kSparseIndexStride + 1).
+  // The persistent index holds a prefix of these slots.
+  std::vector<size_t> sparse_offsets;
+};
+
+typedef BasicLog<LibpmemCopy> Log;
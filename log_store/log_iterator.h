@@ -0,0 +1,90 @@
+/**
+ * @file log_iterator.h
+ * @brief A zero-copy forward iterator over a Log. Header-only.
+ */
+#pragma once
+
+#include <algorithm>
+#include "log.h"
+
+/**
+ * The iterator hands out pointers into the pmem mapping, so entries are never
+ * copied. It prefetches the log's bytes up to prefetch_distance bytes past the
+ * current entry, one cacheline at a time, so that each line is prefetched
+ * once.
+ *
+ * Pointers are valid until the entry is truncated or compacted. The iterator
+ * sees entries appended after it was created.
+ */
+template <typename Copier>
+class BasicLogIterator {
+ public:
+  static constexpr size_t kDefaultPrefetchDistance = KB(2);
+
+  /**
+   * @brief Construct an iterator positioned at the entry at \p start_index.
+   * The start is found through the log's sparse DRAM offset index.
+   *
+   * @param prefetch_distance Bytes to prefetch ahead of the current entry.
+   * Zero disables prefetching.
+   */
+  BasicLogIterator(const BasicLog<Copier> &log, size_t start_index,
+                   size_t prefetch_distance = kDefaultPrefetchDistance)
+      : log(log), prefetch_distance(prefetch_distance) {
+    rt_assert(start_index >= log.get_first_index(),
+              "LogIterator: start index is compacted");
+    rt_assert(start_index <= log.get_last_index() + 1,
+              "LogIterator: start index is past the tail");
+    cur_index = start_index;
+
+    // An iterator at the tail waits at the offset of the next append
+    cur_offset = valid() ? log.offset_of(cur_index) : log.get_used_space();
+    prefetch_offset = cur_offset / 64 * 64;
+    prefetch();
+  }
+
+  /// Return true iff the iterator is positioned at an entry
+  inline bool valid() const { return cur_index <= log.get_last_index(); }
+
+  /// Advance to the next entry. The iterator must be valid.
+  inline void next() {
+    assert(valid());
+    cur_offset += BasicLog<Copier>::get_entry_space(header()->data_size);
+    cur_index++;
+    prefetch();
+  }
+
+  /// Return the current entry's pmem header
+  inline const typename BasicLog<Copier>::EntryHeader *header() const {
+    return log.get_header(cur_offset);
+  }
+
+  /// Return a pointer to the current entry's payload in the pmem mapping
+  inline const uint8_t *data() const {
+    return reinterpret_cast<const uint8_t *>(header() + 1);
+  }
+
+  inline size_t data_size() const { return header()->data_size; }
+  inline size_t index() const { return cur_index; }
+
+ private:
+  /// Prefetch cachelines up to prefetch_distance bytes past the current entry,
+  /// but not past the end of the log
+  inline void prefetch() {
+    const size_t prefetch_end =
+        std::min(cur_offset + prefetch_distance, log.get_used_space());
+    while (prefetch_offset < prefetch_end) {
+      __builtin_prefetch(log.log_base_addr + prefetch_offset, 0 /* read */);
+      prefetch_offset += 64;
+    }
+  }
+
+  const BasicLog<Copier> &log;
+  const size_t prefetch_distance;
+
+  size_t cur_index = 0;
+  size_t cur_offset = 0;       // Byte offset of the current entry
+  size_t prefetch_offset = 0;  // Byte offset of the next line to prefetch
+};
+
+typedef BasicLogIterator<LibpmemCopy> LogIterator;
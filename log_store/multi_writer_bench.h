@@ -0,0 +1,74 @@
+/**
+ * @file multi_writer_bench.h
+ * @brief Scalability of ConcurrentLog appends with the number of writers
+ */
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../common.h"
+#include "concurrent_log.h"
+
+static constexpr size_t kMultiWriterNumaNode = 0;
+static constexpr size_t kMultiWriterNumEntries = 1000000;  // Per config
+
+void multi_writer_thread(ConcurrentLog *log, size_t num_entries,
+                         size_t entry_size, std::atomic<size_t> *num_ready) {
+  uint8_t source[kMaxLogDataSize] = {0};
+
+  // Start all writers together
+  num_ready->fetch_add(1);
+  while (num_ready->load() != 0) __builtin_ia32_pause();
+
+  for (size_t i = 0; i < num_entries; i++) {
+    source[i % entry_size]++;
+    size_t index = log->append(source, entry_size);
+    rt_assert(index != Log::kInvalidIndex, "Multi-writer bench: log full");
+  }
+}
+
+void multi_writer_bench(uint8_t *pbuf, size_t pbuf_size) {
+  const std::vector<size_t> num_writers_vec = {1, 2, 4, 8, 16, 24};
+  const size_t max_writers = num_lcores_per_numa_node();
+
+  printf("writers entry_bytes M_appends_per_sec GBps avg_commit_group\n");
+  for (size_t entry_size = 64; entry_size <= kMaxLogDataSize; entry_size *= 2) {
+    for (size_t num_writers : num_writers_vec) {
+      if (num_writers > max_writers) continue;
+
+      ConcurrentLog log(pbuf, pbuf_size, true /* create_new */);
+
+      // Don't overflow the log
+      const size_t max_entries =
+          log.get_capacity() / Log::get_entry_space(entry_size);
+      const size_t entries_per_writer =
+          std::min(kMultiWriterNumEntries, max_entries) / num_writers;
+
+      std::atomic<size_t> num_ready(0);
+      std::vector<std::thread> threads(num_writers);
+      for (size_t i = 0; i < num_writers; i++) {
+        threads[i] = std::thread(multi_writer_thread, &log, entries_per_writer,
+                                 entry_size, &num_ready);
+        bind_to_core(threads[i], kMultiWriterNumaNode, i);
+      }
+
+      while (num_ready.load() != num_writers) __builtin_ia32_pause();
+      struct timespec bench_start;
+      clock_gettime(CLOCK_REALTIME, &bench_start);
+      num_ready = 0;
+
+      for (auto &t : threads) t.join();
+      double bench_seconds = sec_since(bench_start);
+
+      const size_t tot_entries = entries_per_writer * num_writers;
+      printf("%zu %zu %.2f %.2f %.2f\n", num_writers, entry_size,
+             tot_entries / (bench_seconds * 1000000),
+             tot_entries * entry_size / (bench_seconds * GB(1)),
+             tot_entries * 1.0 / log.get_num_commit_groups());
+    }
+  }
+}
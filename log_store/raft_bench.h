@@ -0,0 +1,89 @@
+/**
+ * @file raft_bench.h
+ * @brief Replay a raft follower's log usage pattern on a persistent Log
+ */
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include "../common.h"
+#include "log.h"
+
+static constexpr size_t kRaftNumEntries = 1000000;  // Appends per measurement
+static constexpr size_t kRaftEntrySize = 256;       // Payload bytes per entry
+static constexpr size_t kRaftBatchSize = 16;  // Entries per AppendEntries RPC
+
+// Every kRaftConflictInterval batches, the follower's log conflicts with a new
+// leader's log, so the last kRaftConflictEntries entries are truncated and
+// re-appended.
+static constexpr size_t kRaftConflictInterval = 1000;
+static constexpr size_t kRaftConflictEntries = 8;
+
+// Every kRaftSnapshotInterval committed entries, the state machine takes a
+// snapshot and the log is compacted up to kRaftRetainEntries behind commit
+static constexpr size_t kRaftSnapshotInterval = 100000;
+static constexpr size_t kRaftRetainEntries = 1000;
+
+void raft_bench(uint8_t *pbuf, size_t pbuf_size) {
+  uint8_t source[kRaftEntrySize] = {0};
+  printf("Raft log: %zu entries of %zu B, batch size %zu\n", kRaftNumEntries,
+         kRaftEntrySize, kRaftBatchSize);
+
+  for (size_t msr = 0; msr < kNumMeasurements; msr++) {
+    size_t num_appends = 0;
+    size_t commit_index = 0;
+    size_t last_snapshot_index = 0;
+
+    {
+      Log log(pbuf, pbuf_size, true /* create_new */);
+      struct timespec bench_start;
+      clock_gettime(CLOCK_REALTIME, &bench_start);
+
+      for (size_t batch = 1; num_appends < kRaftNumEntries; batch++) {
+        if (batch % kRaftConflictInterval == 0 &&
+            log.get_num_entries() > kRaftConflictEntries) {
+          // Truncate only uncommitted entries, like raft
+          size_t conflict_index =
+              log.get_last_index() + 1 - kRaftConflictEntries;
+          if (conflict_index > commit_index) {
+            log.truncate_suffix(conflict_index);
+          }
+        }
+
+        for (size_t i = 0; i < kRaftBatchSize; i++) {
+          source[i % kRaftEntrySize]++;
+          size_t index = log.append(source, kRaftEntrySize);
+          rt_assert(index != Log::kInvalidIndex, "Raft bench: log full");
+        }
+        num_appends += kRaftBatchSize;
+
+        // The leader's commit index trails the follower's log by one batch
+        if (log.get_last_index() > kRaftBatchSize) {
+          commit_index = log.get_last_index() - kRaftBatchSize;
+        }
+
+        if (commit_index - last_snapshot_index >= kRaftSnapshotInterval) {
+          last_snapshot_index = commit_index;
+          log.compact_prefix(commit_index + 1 - kRaftRetainEntries);
+        }
+      }
+
+      double bench_seconds = sec_since(bench_start);
+      printf("Raft log: %.2f M appends/s, %.2f GB/s. Entries [%zu, %zu].\n",
+             num_appends / (bench_seconds * 1000000),
+             num_appends * kRaftEntrySize / (bench_seconds * GB(1)),
+             log.get_first_index(), log.get_last_index());
+    }
+
+    {
+      struct timespec recovery_start;
+      clock_gettime(CLOCK_REALTIME, &recovery_start);
+      Log log(pbuf, pbuf_size, false /* create_new */);
+      double recovery_ms = sec_since(recovery_start) * 1000;
+
+      printf("Raft log: recovered %zu entries ([%zu, %zu]) in %.2f ms\n",
+             log.get_num_entries(), log.get_first_index(),
+             log.get_last_index(), recovery_ms);
+    }
+  }
+}
@@ -1,14 +1,52 @@
+#pragma once
+
 #include <assert.h>
+#include <immintrin.h>
 #include <libpmem.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <algorithm>
+#include "../common.h"
+#include "../utils/pmem_region.h"
+
+/// How a counter buffer is written to pmem
+enum class FlushMethod {
+  kLibpmem,     // pmem_memcpy_persist, which picks the method at runtime
+  kNtStore,     // 8-byte non-temporal store
+  kClwb,        // Regular store, then clwb
+  kClflushopt,  // Regular store, then clflushopt
+};
+
+static const char *flush_method_str(FlushMethod method) {
+  switch (method) {
+    case FlushMethod::kLibpmem:
+      return "libpmem";
+    case FlushMethod::kNtStore:
+      return "ntstore";
+    case FlushMethod::kClwb:
+      return "clwb";
+    case FlushMethod::kClflushopt:
+      return "clflushopt";
+  }
+  return "invalid";
+}
 
-class Counter {
+/**
+ * @brief A persistent counter that rotates its writes over kNumBuffers
+ * buffers spaced kBufferSize bytes apart, to avoid repeatedly writing the same
+ * pmem location. Recovery picks the largest value among the buffers.
+ */
+template <size_t kNumBuffers_, size_t kBufferSize_,
+          FlushMethod kFlushMethod_ = FlushMethod::kLibpmem>
+class RotatingCounter {
  public:
-  static constexpr size_t kNumBuffers = 16;
-  static constexpr size_t kBufferSize = 256;
+  static constexpr size_t kNumBuffers = kNumBuffers_;
+  static constexpr size_t kBufferSize = kBufferSize_;
+  static constexpr FlushMethod kFlushMethod = kFlushMethod_;
+  static_assert(kNumBuffers >= 1, "");
+  static_assert(kBufferSize >= sizeof(size_t), "");
+  static_assert(kBufferSize % sizeof(size_t) == 0, "");
 
   /**
    * @brief Construct a counter
@@ -18,7 +56,7 @@ class Counter {
    * @param create_new If true, the counter is reset to zero. If false, the
    * counter is initialized using the prior pmem contents.
    */
-  Counter(uint8_t *pbuf, bool create_new) : ctr_base_addr(pbuf) {
+  RotatingCounter(uint8_t *pbuf, bool create_new) : ctr_base_addr(pbuf) {
     if (create_new) {
       pmem_memset_persist(pbuf, 0, kNumBuffers * kBufferSize);
     } else {
@@ -37,7 +75,7 @@ class Counter {
     }
   }
 
-  Counter() {}
+  RotatingCounter() {}
 
   /// The amount of contiguous pmem needed for this counter
   static size_t get_reqd_space() { return kNumBuffers * kBufferSize; }
@@ -45,20 +83,77 @@ class Counter {
   // Increment by always writing to the same location
   inline void increment_naive(size_t increment) {
     v_value += increment;
-    pmem_memcpy_persist(&ctr_base_addr[0], &v_value, sizeof(v_value));
+    write_nodrain(&ctr_base_addr[0]);
+    drain();
   }
 
   // Increment by writing to rotating locations, but don't do full-cacheline
   // writes
   inline void increment_rotate(size_t increment) {
     v_value += increment;
-    pmem_memcpy_persist(&ctr_base_addr[buffer_idx * kBufferSize], &v_value,
-                        sizeof(v_value));
+    write_nodrain(&ctr_base_addr[buffer_idx * kBufferSize]);
+    drain();
     buffer_idx = (buffer_idx + 1) % kNumBuffers;
   }
 
+  /**
+   * @brief Set the counter to \p value, which may be smaller than the current
+   * value
+   *
+   * Recovery picks the largest value among the buffers, so all buffers are
+   * overwritten. The buffer holding the current maximum is overwritten last,
+   * so a crash midway recovers the old value.
+   */
+  inline void set_value(size_t value) {
+    v_value = value;
+    for (size_t i = 0; i < kNumBuffers - 1; i++) {
+      size_t idx = (buffer_idx + i) % kNumBuffers;  // Oldest buffers first
+      write_nodrain(&ctr_base_addr[idx * kBufferSize]);
+    }
+    drain();
+
+    size_t max_idx = (buffer_idx + kNumBuffers - 1) % kNumBuffers;
+    write_nodrain(&ctr_base_addr[max_idx * kBufferSize]);
+    drain();
+  }
+
   size_t v_value = 0;  // Volatile value of the counter
 
   size_t buffer_idx = 0;
   uint8_t *ctr_base_addr = nullptr;  // Starting address of the counter on pmem
+
+ private:
+  /// Write v_value to the buffer at \p addr without waiting for persistence
+  inline void write_nodrain(uint8_t *addr) {
+    switch (kFlushMethod) {
+      case FlushMethod::kLibpmem:
+        pmem_memcpy_nodrain(addr, &v_value, sizeof(v_value));
+        break;
+      case FlushMethod::kNtStore:
+        _mm_stream_si64(reinterpret_cast<long long *>(addr),
+                        static_cast<long long>(v_value));
+        break;
+      case FlushMethod::kClwb:
+        *reinterpret_cast<volatile size_t *>(addr) = v_value;
+        pmem_clwb(addr);
+        break;
+      case FlushMethod::kClflushopt:
+        *reinterpret_cast<volatile size_t *>(addr) = v_value;
+        pmem_clflushopt(addr);
+        break;
+    }
+  }
+
+  /// Wait for prior buffer writes to become persistent
+  static inline void drain() {
+    if (kFlushMethod == FlushMethod::kLibpmem) {
+      pmem_drain();
+    } else {
+      sfence();
+    }
+    emul_persist_delay(sizeof(size_t));
+  }
 };
+
+/// The counter used by the logs
+using Counter = RotatingCounter<16, 256>;
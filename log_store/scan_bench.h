@@ -0,0 +1,75 @@
+/**
+ * @file scan_bench.h
+ * @brief Scan bandwidth of the zero-copy LogIterator with different prefetch
+ * distances, compared with a memcpy of the same bytes like
+ * bench_seq_read_tput in microbench
+ */
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "../common.h"
+#include "log.h"
+#include "log_iterator.h"
+
+// Bytes of entries in the scanned log
+static constexpr size_t kScanLogBytes = GB(1);
+
+// Sum the payload in 8-byte words, to emulate a consumer that reads each entry
+static inline size_t scan_consume(const uint8_t *data, size_t data_size) {
+  size_t sum = 0;
+  for (size_t i = 0; i + sizeof(size_t) <= data_size; i += sizeof(size_t)) {
+    size_t word;
+    memcpy(&word, data + i, sizeof(word));
+    sum += word;
+  }
+  return sum;
+}
+
+void scan_bench(uint8_t *pbuf, size_t pbuf_size) {
+  const std::vector<size_t> prefetch_distances = {0, 256, KB(1), KB(4), KB(16)};
+  uint8_t source[kMaxLogDataSize] = {0};
+  const size_t log_size =
+      std::min(pbuf_size, Log::get_metadata_space() + kScanLogBytes);
+  auto *copy_buf = new uint8_t[kScanLogBytes];
+  memset(copy_buf, 0, kScanLogBytes);  // Fault in the pages before timing
+
+  printf("entry_bytes memcpy_GBps");
+  for (size_t distance : prefetch_distances) {
+    printf(" prefetch_%zu_GBps", distance);
+  }
+  printf(" sum\n");
+
+  for (size_t write_sz = 64; write_sz <= kMaxLogDataSize; write_sz *= 4) {
+    Log log(pbuf, log_size, true /* create_new */);
+    while (true) {
+      source[log.get_last_index() % write_sz]++;
+      if (log.append_checksummed(source, write_sz) == Log::kInvalidIndex) break;
+    }
+    const size_t log_bytes = log.get_used_space();
+    size_t sum = 0;
+
+    // Baseline: copy out the log's bytes, like bench_seq_read_tput
+    struct timespec bench_start;
+    clock_gettime(CLOCK_REALTIME, &bench_start);
+    memcpy(copy_buf, pbuf + Log::get_metadata_space(), log_bytes);
+    sum += copy_buf[log_bytes / 2];
+    printf("%zu %.2f", write_sz, log_bytes / (sec_since(bench_start) * GB(1)));
+
+    for (size_t distance : prefetch_distances) {
+      clock_gettime(CLOCK_REALTIME, &bench_start);
+      for (LogIterator it(log, log.get_first_index(), distance); it.valid();
+           it.next()) {
+        sum += scan_consume(it.data(), it.data_size());
+      }
+      printf(" %.2f", log_bytes / (sec_since(bench_start) * GB(1)));
+    }
+
+    printf(" %zu\n", sum);
+  }
+
+  delete[] copy_buf;
+}
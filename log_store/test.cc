@@ -0,0 +1,658 @@
+#include <assert.h>
+#include <gtest/gtest.h>
+#include <libpmem.h>
+#include <thread>
+#include "async_log.h"
+#include "circular_log.h"
+#include "concurrent_log.h"
+#include "log.h"
+#include "log_iterator.h"
+
+static constexpr size_t kLogSize = MB(4);  // Including log metadata
+
+class LogTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    region = map_pmem_region(get_test_pmem_spec(), kLogSize);
+    pbuf = region.buf;
+    mapped_len = region.len;
+  }
+
+  void TearDown() override { unmap_pmem_region(region); }
+
+  // Fill buf with a pattern identifying entry index
+  static void make_entry(size_t index, uint8_t *buf, size_t size) {
+    for (size_t i = 0; i < size; i++) buf[i] = static_cast<uint8_t>(index + i);
+  }
+
+  // Check that the log's entry at index has the pattern for index
+  template <class LogT>
+  static void check_entry(const LogT &log, size_t index, size_t size) {
+    uint8_t expected[KB(4)], actual[KB(4)];
+    size_t actual_size = 0;
+    make_entry(index, expected, size);
+    ASSERT_TRUE(log.read(index, actual, &actual_size));
+    ASSERT_EQ(actual_size, size);
+    ASSERT_EQ(memcmp(expected, actual, size), 0);
+  }
+
+  // Entry size depends on the index to exercise variable-length entries
+  static size_t entry_size(size_t index) { return 1 + (index * 37) % 500; }
+
+  template <class LogT>
+  static void append_entries(LogT &log, size_t num_entries) {
+    uint8_t buf[KB(4)];
+    for (size_t i = 0; i < num_entries; i++) {
+      size_t index = log.get_last_index() + 1;
+      make_entry(index, buf, entry_size(index));
+      ASSERT_EQ(log.append(buf, entry_size(index)), index);
+    }
+  }
+
+  PmemRegion region;
+  uint8_t *pbuf = nullptr;
+  size_t mapped_len = 0;
+};
+
+// Increment a counter, then check that a recovered counter has its value
+template <class CounterT>
+static void check_counter_recovery(uint8_t *pbuf) {
+  {
+    CounterT ctr(pbuf, true /* create_new */);
+    for (size_t i = 1; i <= 100; i++) ctr.increment_rotate(i);
+    ctr.set_value(1000);  // Smaller than the current value
+    ctr.increment_rotate(1);
+  }
+
+  CounterT ctr(pbuf, false /* create_new */);
+  ASSERT_EQ(ctr.v_value, 1001);
+}
+
+TEST_F(LogTest, CounterFlushMethods) {
+  check_counter_recovery<RotatingCounter<1, 8, FlushMethod::kLibpmem>>(pbuf);
+  check_counter_recovery<RotatingCounter<3, 64, FlushMethod::kNtStore>>(pbuf);
+  check_counter_recovery<RotatingCounter<16, 256, FlushMethod::kClwb>>(pbuf);
+  check_counter_recovery<RotatingCounter<5, 4096, FlushMethod::kClflushopt>>(
+      pbuf);
+}
+
+TEST_F(LogTest, AppendRead) {
+  Log log(pbuf, kLogSize, true /* create_new */);
+  ASSERT_EQ(log.get_num_entries(), 0);
+  ASSERT_EQ(log.get_first_index(), 1);
+
+  append_entries(log, 1000);
+  ASSERT_EQ(log.get_last_index(), 1000);
+  for (size_t i = 1; i <= 1000; i++) check_entry(log, i, entry_size(i));
+
+  uint8_t buf[KB(4)];
+  ASSERT_FALSE(log.read(0, buf, nullptr));
+  ASSERT_FALSE(log.read(1001, buf, nullptr));
+}
+
+TEST_F(LogTest, Recovery) {
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, 1000);
+  }
+
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_first_index(), 1);
+  ASSERT_EQ(log.get_last_index(), 1000);
+  for (size_t i = 1; i <= 1000; i++) check_entry(log, i, entry_size(i));
+
+  append_entries(log, 10);
+  check_entry(log, 1010, entry_size(1010));
+}
+
+// Entries written with the SIMD copy kernels are recovered by a libpmem log
+TEST_F(LogTest, SimdCopy) {
+  {
+    BasicLog<SimdCopy> log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, 1000);
+    size_t index = 1;
+    for (BasicLogIterator<SimdCopy> it(log, 1); it.valid(); it.next()) {
+      ASSERT_EQ(it.index(), index);
+      ASSERT_EQ(it.data_size(), entry_size(index));
+      index++;
+    }
+  }
+
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_last_index(), 1000);
+  for (size_t i = 1; i <= 1000; i++) check_entry(log, i, entry_size(i));
+}
+
+TEST_F(LogTest, TruncateSuffix) {
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, 1000);
+    log.truncate_suffix(500);
+    ASSERT_EQ(log.get_last_index(), 499);
+
+    uint8_t buf[KB(4)];
+    ASSERT_FALSE(log.read(500, buf, nullptr));
+
+    append_entries(log, 100);  // Overwrites the truncated entries
+    ASSERT_EQ(log.get_last_index(), 599);
+  }
+
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_last_index(), 599);
+  for (size_t i = 1; i <= 599; i++) check_entry(log, i, entry_size(i));
+}
+
+TEST_F(LogTest, CompactPrefix) {
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, 1000);
+    log.compact_prefix(300);
+    ASSERT_EQ(log.get_first_index(), 300);
+    ASSERT_EQ(log.get_num_entries(), 701);
+
+    uint8_t buf[KB(4)];
+    ASSERT_FALSE(log.read(299, buf, nullptr));
+    check_entry(log, 300, entry_size(300));
+  }
+
+  {
+    Log log(pbuf, kLogSize, false /* create_new */);
+    ASSERT_EQ(log.get_first_index(), 300);
+    ASSERT_EQ(log.get_last_index(), 1000);
+
+    // Compact everything, then truncate to an empty log
+    log.compact_prefix(1001);
+    ASSERT_EQ(log.get_num_entries(), 0);
+  }
+
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_first_index(), 1001);
+  ASSERT_EQ(log.get_num_entries(), 0);
+  append_entries(log, 1);
+  check_entry(log, 1001, entry_size(1001));
+}
+
+TEST_F(LogTest, Iterator) {
+  Log log(pbuf, kLogSize, true /* create_new */);
+  append_entries(log, 1000);
+  log.compact_prefix(100);
+
+  // Start at, inside, and past the end of sparse index strides
+  for (size_t start : {100, 129, 500, 1000, 1001}) {
+    for (size_t distance : {0, 64, 1000}) {
+      size_t expected_index = start;
+      for (LogIterator it(log, start, distance); it.valid(); it.next()) {
+        uint8_t expected[KB(4)];
+        ASSERT_EQ(it.index(), expected_index);
+        ASSERT_EQ(it.header()->index, expected_index);
+        ASSERT_EQ(it.data_size(), entry_size(expected_index));
+        make_entry(expected_index, expected, it.data_size());
+        ASSERT_EQ(memcmp(it.data(), expected, it.data_size()), 0);
+        expected_index++;
+      }
+      ASSERT_EQ(expected_index, 1001);
+    }
+  }
+
+  // The iterator sees entries appended after it reaches the end
+  LogIterator it(log, 1000);
+  it.next();
+  ASSERT_FALSE(it.valid());
+  append_entries(log, 1);
+  ASSERT_TRUE(it.valid());
+  ASSERT_EQ(it.header()->index, 1001);
+
+  // So does an iterator created at the tail
+  LogIterator tailer(log, 1002);
+  ASSERT_FALSE(tailer.valid());
+  append_entries(log, 2);
+  for (size_t index = 1002; index <= 1003; index++) {
+    uint8_t expected[KB(4)];
+    ASSERT_TRUE(tailer.valid());
+    ASSERT_EQ(tailer.index(), index);
+    ASSERT_EQ(tailer.header()->index, index);
+    ASSERT_EQ(tailer.data_size(), entry_size(index));
+    make_entry(index, expected, tailer.data_size());
+    ASSERT_EQ(memcmp(tailer.data(), expected, tailer.data_size()), 0);
+    tailer.next();
+  }
+  ASSERT_FALSE(tailer.valid());
+}
+
+TEST_F(LogTest, PersistentIndex) {
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, 1000);
+    log.compact_prefix(300);
+  }
+
+  {
+    // Recovery walks only the entries after the last persistent slot
+    Log log(pbuf, kLogSize, false /* create_new */);
+    ASSERT_LT(log.get_num_recovery_walked(), Log::kSparseIndexStride);
+    ASSERT_EQ(log.get_first_index(), 300);
+    ASSERT_EQ(log.get_last_index(), 1000);
+
+    // Truncation clears slots of truncated entries, which are then re-added
+    // at different offsets
+    log.truncate_suffix(500);
+    uint8_t buf[KB(4)];
+    for (size_t i = 500; i <= 700; i++) {
+      make_entry(i, buf, entry_size(i) / 2);
+      ASSERT_EQ(log.append(buf, entry_size(i) / 2), i);
+    }
+  }
+
+  {
+    Log log(pbuf, kLogSize, false /* create_new */);
+    ASSERT_LT(log.get_num_recovery_walked(), Log::kSparseIndexStride);
+    ASSERT_EQ(log.get_last_index(), 700);
+    for (size_t i = 300; i < 500; i++) check_entry(log, i, entry_size(i));
+    for (size_t i = 500; i <= 700; i++) check_entry(log, i, entry_size(i) / 2);
+  }
+
+  // Without index maintenance, recovery walks all entries
+  {
+    Log log(pbuf, kLogSize, true /* create_new */, false /* persist_index */);
+    append_entries(log, 1000);
+  }
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_num_recovery_walked(), 1000);
+  for (size_t i = 1; i <= 1000; i++) check_entry(log, i, entry_size(i));
+}
+
+TEST_F(LogTest, UncommittedIndexedEntry) {
+  static constexpr size_t kNumCommitted = 2 * Log::kSparseIndexStride;
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, kNumCommitted);
+
+    // Simulate a crash during the append of entry 129, after its header and
+    // persistent index slot were written but before the counter update
+    uint8_t *entries = pbuf + Log::get_metadata_space();
+    const size_t offset = log.get_used_space();
+    Log::EntryHeader hdr;
+    hdr.index = kNumCommitted + 1;
+    hdr.data_size = 8;
+    hdr.checksum = 0;
+    pmem_memcpy_persist(entries + offset, &hdr, sizeof(hdr));
+
+    auto *index_slots =
+        reinterpret_cast<size_t *>(entries + log.get_capacity());
+    const size_t slot = offset + 1;
+    pmem_memcpy_persist(&index_slots[2], &slot, sizeof(slot));
+  }
+
+  {
+    // The append never returned, so it's not recovered
+    Log log(pbuf, kLogSize, false /* create_new */);
+    ASSERT_EQ(log.get_last_index(), kNumCommitted);
+
+    // Re-append entries so that they cover the stale slot's offset with a
+    // different entry
+    log.truncate_suffix(100);
+    uint8_t buf[KB(4)];
+    for (size_t i = 100; i <= kNumCommitted; i++) {
+      make_entry(i, buf, 2 * entry_size(i));
+      ASSERT_EQ(log.append(buf, 2 * entry_size(i)), i);
+    }
+  }
+
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_last_index(), kNumCommitted);
+  for (size_t i = 1; i < 100; i++) check_entry(log, i, entry_size(i));
+  for (size_t i = 100; i <= kNumCommitted; i++) {
+    check_entry(log, i, 2 * entry_size(i));
+  }
+}
+
+TEST_F(LogTest, Full) {
+  Log log(pbuf, kLogSize, true /* create_new */);
+  std::vector<uint8_t> buf(KB(1));
+
+  size_t num_appended = 0;
+  while (log.append(buf.data(), buf.size()) != Log::kInvalidIndex) {
+    num_appended++;
+  }
+
+  ASSERT_EQ(num_appended, log.get_capacity() / Log::get_entry_space(KB(1)));
+  ASSERT_EQ(log.get_last_index(), num_appended);
+}
+
+TEST_F(LogTest, ChecksummedRecovery) {
+  uint8_t buf[KB(4)];
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, 100);  // Counter-based appends
+
+    for (size_t i = 101; i <= 200; i++) {
+      make_entry(i, buf, entry_size(i));
+      ASSERT_EQ(log.append_checksummed(buf, entry_size(i)), i);
+    }
+  }
+
+  {
+    // Recovery finds the checksummed entries past the counter's tail
+    Log log(pbuf, kLogSize, false /* create_new */);
+    ASSERT_EQ(log.get_last_index(), 200);
+    for (size_t i = 1; i <= 200; i++) check_entry(log, i, entry_size(i));
+
+    // A torn write to entry 200 loses only that entry
+    size_t offset_200 =
+        log.get_used_space() - Log::get_entry_space(entry_size(200));
+    pbuf[Log::get_metadata_space() + offset_200 + sizeof(Log::EntryHeader)]++;
+  }
+
+  {
+    Log log(pbuf, kLogSize, false /* create_new */);
+    ASSERT_EQ(log.get_last_index(), 199);
+
+    // Truncated checksummed entries stay truncated after recovery
+    log.truncate_suffix(150);
+    ASSERT_EQ(log.get_last_index(), 149);
+  }
+
+  {
+    Log log(pbuf, kLogSize, false /* create_new */);
+    ASSERT_EQ(log.get_last_index(), 149);
+    for (size_t i = 1; i <= 149; i++) check_entry(log, i, entry_size(i));
+  }
+
+  {
+    // Entries from an earlier log in the same space are not recovered
+    Log log(pbuf, kLogSize, true /* create_new */);
+    make_entry(1, buf, entry_size(1));
+    ASSERT_EQ(log.append_checksummed(buf, entry_size(1)), 1);
+  }
+
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_last_index(), 1);
+}
+
+TEST_F(LogTest, TruncateReappendIdentical) {
+  uint8_t buf[KB(4)];
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    for (size_t i = 1; i <= 200; i++) {
+      make_entry(i, buf, entry_size(i));
+      ASSERT_EQ(log.append_checksummed(buf, entry_size(i)), i);
+    }
+
+    // Re-append the same entry 150, e.g., on a raft retry. The stale entries
+    // after it would chain-validate if truncation didn't change checksums.
+    log.truncate_suffix(150);
+    make_entry(150, buf, entry_size(150));
+    ASSERT_EQ(log.append_checksummed(buf, entry_size(150)), 150);
+  }
+
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_last_index(), 150);
+  for (size_t i = 1; i <= 150; i++) check_entry(log, i, entry_size(i));
+}
+
+TEST_F(LogTest, ConcurrentAppend) {
+  static constexpr size_t kNumWriters = 8;
+  static constexpr size_t kEntriesPerWriter = 2000;
+
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, 10);
+  }
+
+  {
+    ConcurrentLog clog(pbuf, kLogSize, false /* create_new */);
+
+    // Each entry records its writer and its sequence number at that writer
+    std::vector<std::thread> threads(kNumWriters);
+    for (size_t i = 0; i < kNumWriters; i++) {
+      threads[i] = std::thread([&clog, i] {
+        size_t prev_index = 0;
+        for (size_t j = 0; j < kEntriesPerWriter; j++) {
+          size_t payload[2] = {i, j};
+          size_t size = sizeof(payload) + (j % 3) * 8;  // Variable sizes
+          uint8_t buf[64] = {0};
+          memcpy(buf, payload, sizeof(payload));
+
+          size_t index = clog.append(buf, size);
+          ASSERT_GT(index, prev_index);
+          prev_index = index;
+        }
+      });
+    }
+    for (auto &t : threads) t.join();
+
+    ASSERT_EQ(clog.get_last_index(), 10 + kNumWriters * kEntriesPerWriter);
+    ASSERT_LE(clog.get_num_commit_groups(), kNumWriters * kEntriesPerWriter);
+  }
+
+  // Each writer's entries must appear in order
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_last_index(), 10 + kNumWriters * kEntriesPerWriter);
+  for (size_t i = 1; i <= 10; i++) check_entry(log, i, entry_size(i));
+
+  std::vector<size_t> next_seq(kNumWriters, 0);
+  for (size_t i = 11; i <= log.get_last_index(); i++) {
+    uint8_t buf[64];
+    size_t size;
+    ASSERT_TRUE(log.read(i, buf, &size));
+
+    size_t payload[2];
+    memcpy(payload, buf, sizeof(payload));
+    ASSERT_LT(payload[0], kNumWriters);
+    ASSERT_EQ(payload[1], next_seq[payload[0]]);
+    ASSERT_EQ(size, sizeof(payload) + (payload[1] % 3) * 8);
+    next_seq[payload[0]]++;
+  }
+}
+
+TEST_F(LogTest, ConcurrentAppendFull) {
+  static constexpr size_t kBigSize = KB(4);
+  uint8_t buf[kBigSize];
+  size_t last_index = 0;
+
+  {
+    ConcurrentLog clog(pbuf, kLogSize, true /* create_new */);
+    for (size_t index = 1;; index++) {
+      make_entry(index, buf, kBigSize);
+      const size_t ret = clog.append(buf, kBigSize);
+      if (ret == Log::kInvalidIndex) break;
+      ASSERT_EQ(ret, index);
+      last_index = index;
+    }
+
+    // Failed appends reserve nothing, so retries and smaller entries work
+    for (size_t i = 0; i < 1000; i++) {
+      ASSERT_EQ(clog.append(buf, kBigSize), Log::kInvalidIndex);
+    }
+    while (true) {
+      make_entry(last_index + 1, buf, 8);
+      if (clog.append(buf, 8) == Log::kInvalidIndex) break;
+      last_index++;
+      ASSERT_EQ(clog.get_last_index(), last_index);
+    }
+  }
+
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_last_index(), last_index);
+  check_entry(log, 1, kBigSize);
+  check_entry(log, last_index, 8);
+}
+
+TEST_F(LogTest, AsyncAppend) {
+  {
+    Log log(pbuf, kLogSize, true /* create_new */);
+    append_entries(log, 10);
+  }
+
+  std::atomic<size_t> callback_index(0);
+  auto callback = [](size_t durable_index, void *context) {
+    auto *max_index = reinterpret_cast<std::atomic<size_t> *>(context);
+    ASSERT_GT(durable_index, max_index->load());
+    max_index->store(durable_index);
+  };
+
+  // A small staging ring so that appends wrap around it and wait for space
+  static constexpr size_t kNumEntries = 5000;
+  {
+    AsyncLog alog(pbuf, kLogSize, false /* create_new */, KB(8));
+    alog.set_durable_callback(callback, &callback_index);
+    ASSERT_EQ(alog.get_durable_index(), 10);
+
+    uint8_t buf[KB(4)];
+    for (size_t i = 11; i <= 10 + kNumEntries; i++) {
+      make_entry(i, buf, entry_size(i));
+      ASSERT_EQ(alog.append(buf, entry_size(i)), i);
+      ASSERT_LE(alog.get_durable_index(), i);
+    }
+
+    alog.wait_durable(10 + kNumEntries / 2);
+    ASSERT_GE(alog.get_durable_index(), 10 + kNumEntries / 2);
+  }  // The destructor persists the remaining entries
+
+  ASSERT_EQ(callback_index.load(), 10 + kNumEntries);
+  Log log(pbuf, kLogSize, false /* create_new */);
+  ASSERT_EQ(log.get_last_index(), 10 + kNumEntries);
+  for (size_t i = 1; i <= log.get_last_index(); i++) {
+    check_entry(log, i, entry_size(i));
+  }
+}
+
+// A small ring so that the tests below wrap around many times
+static constexpr size_t kCircularRingSize = KB(4) + 24;
+
+TEST_F(LogTest, CircularWraparound) {
+  const size_t pbuf_size =
+      CircularLog::get_metadata_space() + kCircularRingSize;
+  CircularLog clog(pbuf, pbuf_size, true /* create_new */);
+  ASSERT_EQ(clog.get_capacity(), kCircularRingSize);
+
+  // Interleave appends and reads so that entries and headers straddle the end
+  // of the ring at varying offsets
+  uint8_t buf[KB(4)];
+  size_t next_append = 1, next_read = 1;
+  size_t num_straddling = 0;
+  while (next_read <= 1000) {
+    while (true) {
+      make_entry(next_append, buf, entry_size(next_append));
+      size_t lsn = clog.append(buf, entry_size(next_append));
+      if (lsn == CircularLog::kInvalidLsn) break;
+
+      size_t ring_offset = lsn % kCircularRingSize;
+      size_t space = CircularLog::get_entry_space(entry_size(next_append));
+      if (ring_offset + space > kCircularRingSize) num_straddling++;
+      next_append++;
+    }
+    ASSERT_LE(clog.get_tail() - clog.get_head(), kCircularRingSize);
+
+    // Free a few entries
+    for (size_t i = 0; i < 3 && next_read < next_append; i++) {
+      uint8_t expected[KB(4)];
+      size_t size, lsn;
+      ASSERT_TRUE(clog.read_next(buf, &size, &lsn));
+      ASSERT_EQ(size, entry_size(next_read));
+      make_entry(next_read, expected, size);
+      ASSERT_EQ(memcmp(buf, expected, size), 0);
+      next_read++;
+    }
+    clog.trim(clog.get_read_cursor());
+  }
+
+  ASSERT_GT(num_straddling, 0);
+}
+
+TEST_F(LogTest, CircularFull) {
+  const size_t pbuf_size =
+      CircularLog::get_metadata_space() + kCircularRingSize;
+  CircularLog clog(pbuf, pbuf_size, true /* create_new */);
+
+  uint8_t buf[KB(4)] = {0};
+  const size_t data_size = 1000;
+  const size_t space = CircularLog::get_entry_space(data_size);
+  const size_t num_fit = kCircularRingSize / space;
+  for (size_t i = 0; i < num_fit; i++) {
+    ASSERT_EQ(clog.append(buf, data_size), i * space);
+  }
+  ASSERT_EQ(clog.append(buf, data_size), CircularLog::kInvalidLsn);
+
+  // Reading alone doesn't free space, trimming does
+  size_t size;
+  ASSERT_TRUE(clog.read_next(buf, &size, nullptr));
+  ASSERT_EQ(clog.append(buf, data_size), CircularLog::kInvalidLsn);
+  clog.trim(clog.get_read_cursor());
+  ASSERT_EQ(clog.append(buf, data_size), num_fit * space);
+}
+
+TEST_F(LogTest, CircularRecovery) {
+  const size_t pbuf_size =
+      CircularLog::get_metadata_space() + kCircularRingSize;
+  uint8_t buf[KB(4)];
+  size_t head, tail;
+
+  {
+    CircularLog clog(pbuf, pbuf_size, true /* create_new */);
+    for (size_t i = 1; i <= 200; i++) {
+      make_entry(i, buf, entry_size(i) % 100);
+      if (clog.append(buf, entry_size(i) % 100) == CircularLog::kInvalidLsn) {
+        // Free the whole ring and retry
+        size_t size;
+        while (clog.read_next(buf, &size, nullptr)) {
+          clog.trim(clog.get_read_cursor());
+        }
+        i--;
+      }
+    }
+
+    // Leave a few entries read but untrimmed
+    size_t size;
+    for (size_t i = 0; i < 5; i++) {
+      ASSERT_TRUE(clog.read_next(buf, &size, nullptr));
+    }
+    head = clog.get_head();
+    tail = clog.get_tail();
+    ASSERT_GT(head, kCircularRingSize);
+  }
+
+  CircularLog clog(pbuf, pbuf_size, false /* create_new */);
+  ASSERT_EQ(clog.get_head(), head);
+  ASSERT_EQ(clog.get_tail(), tail);
+  ASSERT_EQ(clog.get_read_cursor(), head);  // Untrimmed entries are re-read
+
+  size_t num_entries = 0, size;
+  while (clog.read_next(buf, &size, nullptr)) num_entries++;
+  ASSERT_GT(num_entries, 5);
+  ASSERT_EQ(clog.get_read_cursor(), tail);
+}
+
+TEST_F(LogTest, CircularProducerConsumer) {
+  static constexpr size_t kNumEntries = 20000;
+  const size_t pbuf_size =
+      CircularLog::get_metadata_space() + kCircularRingSize;
+  CircularLog clog(pbuf, pbuf_size, true /* create_new */);
+
+  std::thread producer([&clog] {
+    uint8_t buf[KB(4)];
+    for (size_t i = 1; i <= kNumEntries; i++) {
+      make_entry(i, buf, entry_size(i));
+      while (clog.append(buf, entry_size(i)) == CircularLog::kInvalidLsn) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint8_t buf[KB(4)], expected[KB(4)];
+  for (size_t i = 1; i <= kNumEntries; i++) {
+    size_t size;
+    while (!clog.read_next(buf, &size, nullptr)) std::this_thread::yield();
+    ASSERT_EQ(size, entry_size(i));
+    make_entry(i, expected, size);
+    ASSERT_EQ(memcmp(buf, expected, size), 0);
+    if (i % 4 == 0) clog.trim(clog.get_read_cursor());
+  }
+
+  producer.join();
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
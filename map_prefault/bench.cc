@@ -0,0 +1,300 @@
+/**
+ * @file bench.cc
+ * @brief Measure the cold-start cost of mapping pmem, across mapping
+ * alignments, MAP_SYNC, and prefault strategies
+ *
+ * For each configuration, the region is mapped fresh at the given virtual
+ * alignment (4 KB, 2 MB or 1 GB, which decides the largest page size the
+ * kernel can use), and optionally prefaulted with MAP_POPULATE or by threads
+ * that touch every page. A first pass then writes the region sequentially in
+ * 4 KB copies, timing each page's first write and the bandwidth of each
+ * window. A second pass over the faulted region gives the steady bandwidth.
+ *
+ * Each row reports the mapping and prefault times, the first-touch latency
+ * distribution, and the time from the start of mapping until a window first
+ * reaches 90% of the steady bandwidth. Configurations that the kernel rejects,
+ * e.g., MAP_SYNC on DRAM, report the error instead.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gflags/gflags.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "../common.h"
+#include "../utils/parse_list.h"
+#include "../utils/result_writer.h"
+#include "../utils/timer.h"
+
+// Older glibc headers lack these
+#ifndef MAP_SHARED_VALIDATE
+#define MAP_SHARED_VALIDATE 0x03
+#endif
+#ifndef MAP_SYNC
+#define MAP_SYNC 0x80000
+#endif
+
+DEFINE_string(pmem_files, "/dev/dax0.0",
+              "Comma-separated devdax devices, fsdax files, or emul:dram, or "
+              "emul:<path> for a regular file");
+DEFINE_uint64(region_size, GB(8), "Bytes mapped and written");
+DEFINE_string(aligns, "4K,2M,1G",
+              "Comma-separated virtual address alignments, with an optional "
+              "K, M or G suffix");
+DEFINE_string(map_sync, "0,1", "Comma-separated MAP_SYNC settings");
+DEFINE_string(prefaults, "none,populate,threads",
+              "Comma-separated prefault strategies: none, populate "
+              "(MAP_POPULATE), or threads");
+DEFINE_string(prefault_threads, "1,8",
+              "Comma-separated thread counts for the threads strategy");
+DEFINE_uint64(window_size, MB(64), "Bytes per bandwidth window");
+DEFINE_double(full_bw_fraction, 0.9,
+              "Fraction of the steady bandwidth that counts as full");
+DEFINE_string(format, "csv", "Result format: csv or json");
+DEFINE_string(output_file, "",
+              "Append results to this file. Empty means stdout.");
+
+static constexpr size_t kPageSize = KB(4);
+static constexpr size_t kMaxLatencySamples = MB(1);
+
+struct MapConfig {
+  std::string spec;
+  size_t align;
+  bool map_sync;
+  std::string prefault;
+  size_t prefault_threads;  // For the threads strategy
+};
+
+/**
+ * @brief Map \p len bytes of \p config.spec at a virtual address aligned to
+ * \p config.align
+ *
+ * @return The mapping, or nullptr with \p err set if mmap failed
+ */
+static uint8_t *map_aligned(const MapConfig &config, size_t len,
+                            std::string *err) {
+  const bool is_dram = config.spec == "emul:dram";
+  const std::string path = config.spec.compare(0, 5, "emul:") == 0
+                               ? config.spec.substr(5)
+                               : config.spec;
+
+  int fd = -1;
+  if (!is_dram) {
+    const bool is_devdax = path.find("/dev/dax") == 0;
+    fd = open(path.c_str(), is_devdax ? O_RDWR : O_RDWR | O_CREAT, 0666);
+    rt_assert(fd >= 0, "open failed for " + path);
+    struct stat st;
+    rt_assert(fstat(fd, &st) == 0, "fstat failed for " + path);
+    if (!is_devdax && static_cast<size_t>(st.st_size) < len) {
+      rt_assert(ftruncate(fd, static_cast<off_t>(len)) == 0,
+                "ftruncate failed for " + path);
+    }
+  }
+
+  // Reserve enough address space to place the mapping at the alignment
+  void *reserved = mmap(nullptr, len + config.align, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  rt_assert(reserved != MAP_FAILED, "Address space reservation failed");
+  const size_t reserved_start = reinterpret_cast<size_t>(reserved);
+  const size_t start =
+      (reserved_start + config.align - 1) / config.align * config.align;
+  auto *addr = reinterpret_cast<void *>(start);
+
+  // MAP_SYNC is checked only with MAP_SHARED_VALIDATE, which fails for DRAM
+  int flags = MAP_FIXED;
+  flags |= config.map_sync ? MAP_SHARED_VALIDATE | MAP_SYNC
+                           : (is_dram ? MAP_PRIVATE : MAP_SHARED);
+  if (is_dram) flags |= MAP_ANONYMOUS | MAP_NORESERVE;
+  if (config.prefault == "populate") flags |= MAP_POPULATE;
+
+  void *buf = mmap(addr, len, PROT_READ | PROT_WRITE, flags, fd, 0);
+  const int mmap_errno = errno;
+  if (fd >= 0) close(fd);
+
+  // Release the reservation around the mapping, or all of it on failure
+  if (buf == MAP_FAILED) {
+    munmap(reserved, len + config.align);
+    *err = strerror(mmap_errno);
+    return nullptr;
+  }
+  if (start > reserved_start) munmap(reserved, start - reserved_start);
+  const size_t reserved_end = reserved_start + len + config.align;
+  if (start + len < reserved_end) {
+    munmap(reinterpret_cast<void *>(start + len), reserved_end - start - len);
+  }
+
+  if (is_dram && config.align >= MB(2)) madvise(buf, len, MADV_HUGEPAGE);
+  return static_cast<uint8_t *>(buf);
+}
+
+/// Fault in every page of [buf, buf + len) with one write per page
+static void prefault_thread(uint8_t *buf, size_t len) {
+  for (size_t i = 0; i < len; i += kPageSize) {
+    *reinterpret_cast<volatile uint8_t *>(&buf[i]) = 0;
+  }
+}
+
+struct PassResult {
+  double sec = 0.0;
+  std::vector<double> window_GBps;
+  std::vector<double> window_end_sec;  // Since the pass started
+  std::vector<size_t> page_cycles;     // Sampled per-page copy latencies
+};
+
+/// Write \p buf sequentially in page-sized persistent copies
+static PassResult write_pass(uint8_t *buf, size_t len, bool record_pages) {
+  PassResult result;
+  auto *src = static_cast<uint8_t *>(aligned_alloc(kPageSize, kPageSize));
+  memset(src, 31, kPageSize);
+  const size_t num_pages = len / kPageSize;
+  const size_t sample_every =
+      std::max(1ul, num_pages / kMaxLatencySamples);  // Bounds the samples
+
+  struct timespec start, window_start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  window_start = start;
+  for (size_t page = 0; page < num_pages; page++) {
+    uint8_t *dst = &buf[page * kPageSize];
+    if (record_pages && page % sample_every == 0) {
+      const size_t start_tsc = timer::Start();
+      pmem_memcpy_nodrain(dst, src, kPageSize);
+      result.page_cycles.push_back(timer::Stop() - start_tsc);
+    } else {
+      pmem_memcpy_nodrain(dst, src, kPageSize);
+    }
+
+    const size_t bytes = (page + 1) * kPageSize;
+    if (bytes % FLAGS_window_size == 0 || page == num_pages - 1) {
+      pmem_drain();
+      const size_t window_bytes = (bytes - 1) % FLAGS_window_size + 1;
+      result.window_GBps.push_back(window_bytes / ns_since(window_start));
+      result.window_end_sec.push_back(sec_since(start));
+      clock_gettime(CLOCK_REALTIME, &window_start);
+    }
+  }
+
+  result.sec = sec_since(start);
+  free(src);
+  return result;
+}
+
+static double percentile_ns(const std::vector<size_t> &sorted, double p,
+                            double freq_ghz) {
+  if (sorted.empty()) return -1.0;
+  const size_t idx = std::min(sorted.size() - 1,
+                              static_cast<size_t>(sorted.size() * p / 100));
+  return sorted[idx] / freq_ghz;
+}
+
+void run_config(const MapConfig &config, double freq_ghz,
+                ResultWriter &writer) {
+  const size_t len = FLAGS_region_size / kPageSize * kPageSize;
+  ResultRow row;
+  row.add("pmem_file", config.spec).add("align", config.align);
+  row.add("map_sync", static_cast<size_t>(config.map_sync));
+  row.add("prefault", config.prefault);
+  row.add("prefault_threads", config.prefault_threads);
+
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  std::string err;
+  uint8_t *buf = map_aligned(config, len, &err);
+  if (buf == nullptr) {
+    // Keep the columns of successful rows, so that CSV output stays uniform
+    row.add("status", "mmap: " + err);
+    for (const char *key : {"map_ms", "prefault_ms", "touch_p50_ns",
+                            "touch_p99_ns", "touch_max_ns", "first_pass_GBps",
+                            "steady_GBps", "time_to_full_bw_ms"}) {
+      row.add(key, -1.0);
+    }
+    writer.write(row);
+    return;
+  }
+  const double map_ms = ns_since(start) / 1000000;
+
+  struct timespec prefault_start;
+  clock_gettime(CLOCK_REALTIME, &prefault_start);
+  if (config.prefault == "threads") {
+    const size_t n = config.prefault_threads;
+    const size_t part = len / n / kPageSize * kPageSize;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n; i++) {
+      const size_t part_len = i == n - 1 ? len - i * part : part;
+      threads.emplace_back(prefault_thread, buf + i * part, part_len);
+    }
+    for (auto &t : threads) t.join();
+  }
+  const double prefault_ms = ns_since(prefault_start) / 1000000;
+  const double setup_sec = sec_since(start);
+
+  PassResult first = write_pass(buf, len, true /* record_pages */);
+  PassResult steady = write_pass(buf, len, false /* record_pages */);
+  munmap(buf, len);
+
+  const double steady_GBps = len / (steady.sec * 1000000000);
+  double time_to_full_bw_ms = (setup_sec + first.sec) * 1000;
+  for (size_t w = 0; w < first.window_GBps.size(); w++) {
+    if (first.window_GBps[w] >= FLAGS_full_bw_fraction * steady_GBps) {
+      time_to_full_bw_ms = (setup_sec + first.window_end_sec[w]) * 1000;
+      break;
+    }
+  }
+
+  std::sort(first.page_cycles.begin(), first.page_cycles.end());
+  row.add("status", "ok").add("map_ms", map_ms);
+  row.add("prefault_ms", prefault_ms);
+  row.add("touch_p50_ns", percentile_ns(first.page_cycles, 50, freq_ghz));
+  row.add("touch_p99_ns", percentile_ns(first.page_cycles, 99, freq_ghz));
+  row.add("touch_max_ns", first.page_cycles.back() / freq_ghz);
+  row.add("first_pass_GBps", len / (first.sec * 1000000000));
+  row.add("steady_GBps", steady_GBps);
+  row.add("time_to_full_bw_ms", time_to_full_bw_ms);
+  writer.write(row);
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  const double freq_ghz = measure_rdtsc_freq();
+
+  ResultWriter writer(FLAGS_format, FLAGS_output_file);
+  ResultRow metadata;
+  metadata.add("region_size", static_cast<size_t>(FLAGS_region_size));
+  metadata.add("window_size", static_cast<size_t>(FLAGS_window_size));
+  metadata.add("rdtsc_freq_ghz", freq_ghz);
+  writer.write_metadata(metadata);
+
+  for (const std::string &spec : parse_str_list(FLAGS_pmem_files)) {
+    for (const std::string &align : parse_str_list(FLAGS_aligns)) {
+      for (const std::string &map_sync : parse_str_list(FLAGS_map_sync)) {
+        for (const std::string &prefault : parse_str_list(FLAGS_prefaults)) {
+          rt_assert(prefault == "none" || prefault == "populate" ||
+                        prefault == "threads",
+                    "Invalid prefault strategy " + prefault);
+          const std::vector<std::string> thread_counts =
+              prefault == "threads" ? parse_str_list(FLAGS_prefault_threads)
+                                    : std::vector<std::string>{"0"};
+          for (const std::string &threads : thread_counts) {
+            MapConfig config;
+            config.spec = spec;
+            config.align = parse_size(align);
+            config.map_sync = map_sync == "1";
+            config.prefault = prefault;
+            config.prefault_threads = std::stoull(threads);
+            run_config(config, freq_ghz, writer);
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,4 @@
+exe="./bench"
+chmod +x $exe
+
+numactl --cpunodebind=0 --membind=0 $exe "$@"
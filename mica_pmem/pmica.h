@@ -11,6 +11,8 @@
 #include <stdexcept>
 #include <string>
 #include <vector>
+#include "../utils/pmem_copy.h"
+#include "../utils/pmem_region.h"
 
 namespace pmica {
 
@@ -50,7 +52,9 @@ static constexpr T roundup(T x) {
   return ((x) + T(PowerOfTwoNumber - 1)) & (~T(PowerOfTwoNumber - 1));
 }
 
-template <typename Key, typename Value>
+/// Copier is the pmem copy policy for slot and redo log writes. See
+/// utils/pmem_copy.h.
+template <typename Key, typename Value, typename Copier = LibpmemCopy>
 class HashMap {
  public:
   enum class State : size_t { kEmpty = 0, kFull, kDelete };  // Slot state
@@ -91,27 +95,13 @@ class HashMap {
     size_t committed_seq_num;
   };
 
-  // Initialize the persistent buffer for this hash table. This modifies only
-  // mapped_len.
-  uint8_t* map_pbuf(size_t& _mapped_len) const {
-    int is_pmem;
-    uint8_t* pbuf = reinterpret_cast<uint8_t*>(
-        pmem_map_file(pmem_file.c_str(), 0 /* length */, 0 /* flags */, 0666,
-                      &_mapped_len, &is_pmem));
-
-    rt_assert(pbuf != nullptr, "pmem_map_file() failed for " + pmem_file);
-    rt_assert(reinterpret_cast<size_t>(pbuf) % 256 == 0, "pbuf not aligned");
-
-    if (mapped_len - file_offset < reqd_space) {
-      fprintf(stderr,
-              "pmem file too small. %.2f GB required for hash table "
-              "(%zu buckets, bucket size = %zu), but only %.2f GB available\n",
-              reqd_space * 1.0 / (1ull << 30), num_total_buckets,
-              sizeof(Bucket), mapped_len * 1.0 / (1ull << 30));
-    }
-    rt_assert(is_pmem == 1, "File is not pmem");
-
-    return pbuf + file_offset;
+  // Map the persistent buffer for this hash table. This modifies only region.
+  // pmem_file may name an emulated region, see utils/pmem_region.h.
+  uint8_t* map_pbuf() {
+    region = map_pmem_region(pmem_file, file_offset + reqd_space);
+    rt_assert(reinterpret_cast<size_t>(region.buf) % 256 == 0,
+              "pbuf not aligned");
+    return region.buf + file_offset;
   }
 
   // Allocate a hash table with space for \p num_keys keys, and chain overflow
@@ -137,7 +127,7 @@ class HashMap {
            reqd_space * 1.0 / (1ull << 30), get_key_capacity() / 1000000.0,
            sizeof(Bucket));
 
-    pbuf = map_pbuf(mapped_len);
+    pbuf = map_pbuf();
 
     // Set the committed seq num, and all redo log entry seq nums to zero.
     redo_log = reinterpret_cast<RedoLog*>(pbuf);
@@ -166,7 +156,7 @@ class HashMap {
   }
 
   ~HashMap() {
-    if (pbuf != nullptr) pmem_unmap(pbuf - file_offset, mapped_len);
+    unmap_pmem_region(region);
   }
 
   /// Return the total bytes required for a table with \p num_requested_keys
@@ -259,36 +249,38 @@ class HashMap {
   void batch_op_drain_helper(bool* is_set, size_t* keyhash_arr,
                              const Key** key_arr, Value** value_arr,
                              bool* success_arr, size_t n) {
-    bool all_gets = true;
+    size_t num_sets = 0;
     for (size_t i = 0; i < n; i++) {
       if (is_set[i]) {
-        all_gets = false;
+        num_sets++;
         RedoLogEntry v_rle(cur_sequence_number, key_arr[i], value_arr[i]);
 
         // Drain all pending writes to the table when we reuse log entries
-        if (cur_sequence_number % kNumRedoLogEntries == 0) pmem_drain();
+        if (cur_sequence_number % kNumRedoLogEntries == 0) Copier::drain();
 
         RedoLogEntry& p_rle =
             redo_log->entries[cur_sequence_number % kNumRedoLogEntries];
 
         if (opts.redo_batch) {
           // We will write to the committed sequence number later
-          pmem_memcpy_nodrain(&p_rle, &v_rle, sizeof(v_rle));
+          Copier::copy_nodrain(&p_rle, &v_rle, sizeof(v_rle));
         } else {
-          pmem_memcpy_persist(&p_rle, &v_rle, sizeof(v_rle));
-          pmem_memcpy_persist(&redo_log->committed_seq_num,
-                              &cur_sequence_number, sizeof(size_t));
+          Copier::copy_persist(&p_rle, &v_rle, sizeof(v_rle));
+          Copier::copy_persist(&redo_log->committed_seq_num,
+                               &cur_sequence_number, sizeof(size_t));
+          emul_persist_delay(sizeof(v_rle));
         }
 
         cur_sequence_number++;  // Just the in-memory copy
       }
     }
 
-    if (opts.redo_batch && !all_gets) {
+    if (opts.redo_batch && num_sets > 0) {
       // This is needed only if redo log batching is enabled
-      pmem_drain();  // Block until the redo log entries are persistent
-      pmem_memcpy_persist(&redo_log->committed_seq_num, &cur_sequence_number,
-                          sizeof(size_t));
+      Copier::drain();  // Block until the redo log entries are persistent
+      Copier::copy_persist(&redo_log->committed_seq_num,
+                           &cur_sequence_number, sizeof(size_t));
+      emul_persist_delay(num_sets * sizeof(RedoLogEntry));
     }
 
     for (size_t i = 0; i < n; i++) {
@@ -354,8 +346,9 @@ class HashMap {
     }
 
     // This is an eight-byte operation, so no need in redo log
-    pmem_memcpy_persist(&bucket->next_extra_bucket_idx, &extra_bucket_index,
-                        sizeof(extra_bucket_index));
+    Copier::copy_persist(&bucket->next_extra_bucket_idx, &extra_bucket_index,
+                         sizeof(extra_bucket_index));
+    emul_persist_delay(sizeof(extra_bucket_index));
     return true;
   }
 
@@ -431,9 +424,12 @@ class HashMap {
 
     Slot s(*key, *value);
     if (opts.async_drain) {
-      pmem_memcpy_nodrain(&located_bucket->slot_arr[item_index], &s, sizeof(s));
+      Copier::copy_nodrain(&located_bucket->slot_arr[item_index], &s,
+                           sizeof(s));
     } else {
-      pmem_memcpy_persist(&located_bucket->slot_arr[item_index], &s, sizeof(s));
+      Copier::copy_persist(&located_bucket->slot_arr[item_index], &s,
+                           sizeof(s));
+      emul_persist_delay(sizeof(s));
     }
 
     return true;
@@ -465,7 +461,7 @@ class HashMap {
   std::vector<size_t> extra_bucket_free_list;
 
   uint8_t* pbuf;      // The pmem buffer for this table
-  size_t mapped_len;  // The length mapped by libpmem
+  PmemRegion region;  // The mapping that contains pbuf
   RedoLog* redo_log;
   size_t cur_sequence_number = 1;
 
@@ -4,7 +4,7 @@
 #include "pmica.h"
 
 static constexpr size_t kDefaultFileOffset = 1024;
-static constexpr const char* kPmemFile = "/mnt/pmem12/raft_log";
+static const std::string kPmemFile = get_test_pmem_spec();
 
 TEST(Basic, Simple) {
   size_t num_keys = 32;
@@ -75,6 +75,24 @@ TEST(Basic, Overload) {
   }
 }
 
+TEST(Basic, SimdCopy) {
+  size_t num_keys = 32;
+  pmica::HashMap<size_t, size_t, SimdCopy> hashmap(
+      kPmemFile, kDefaultFileOffset, num_keys, 1.0);
+
+  std::map<size_t, bool> insert_success_map;
+  for (size_t i = 1; i <= num_keys; i++) {
+    insert_success_map[i] = hashmap.set_nodrain(&i, &i);
+  }
+
+  for (size_t i = 1; i <= num_keys; i++) {
+    size_t v;
+    bool success = hashmap.get(&i, &v);
+    assert(success == insert_success_map[i]);
+    if (success) assert(v == i);
+  }
+}
+
 TEST(Basic, Large) {
   pmica::HashMap<size_t, size_t> hashmap(kPmemFile, kDefaultFileOffset,
                                          (1ull << 30), 0.2);
@@ -1,5 +1,10 @@
 #include "bench.h"
 
+#include "copy_kernels.h"
+#include "handoff_latency.h"
+#include "mixed_tput.h"
+#include "multi_stream_write.h"
+#include "numa_sweep.h"
 #include "rand_read_latency.h"
 #include "rand_read_tput.h"
 #include "rand_write_latency.h"
@@ -7,222 +12,454 @@
 #include "seq_read_tput.h"
 #include "seq_write_latency.h"
 #include "seq_write_tput.h"
-
-// Return true if kPmemFile is in devdax mode
-static bool is_pmem_file_devdax() {
-  if (std::string(kPmemFile).find("dax") != std::string::npos) return true;
-  return false;
+#include "write_open_loop.h"
+#include "write_timeline.h"
+
+DEFINE_string(benchmark, "seq_write_tput",
+              "Comma-separated benchmarks to run, or \"all\". See --list.");
+DEFINE_bool(list, false, "List the available benchmarks and exit");
+DEFINE_string(threads, "",
+              "Comma-separated thread counts to sweep. Empty means the "
+              "benchmark's default.");
+DEFINE_string(sizes, "",
+              "Comma-separated sizes in bytes to sweep, with an optional K, M "
+              "or G suffix. Empty means the benchmark's default.");
+DEFINE_string(format, "csv", "Result format: csv or json");
+DEFINE_string(output_file, "",
+              "Append results to this file. Empty means stdout.");
+DEFINE_string(rates, "0.1,0.2,0.5,1,2,4",
+              "Comma-separated offered loads in M ops/s for open-loop "
+              "benchmarks");
+DEFINE_string(arrival, "poisson",
+              "Arrival process for open-loop benchmarks: poisson or constant");
+DEFINE_string(read_pcts, "0,25,50,75,100",
+              "Comma-separated read percents for mixed_tput");
+DEFINE_string(mixed_roles, "mixed",
+              "Thread roles for mixed_tput: mixed, or dedicated readers and "
+              "writers");
+DEFINE_string(pattern, "rand",
+              "Access pattern for mixed_tput and write_timeline: rand or seq");
+DEFINE_string(streams, "1,2,4,8,16,32,64",
+              "Comma-separated sequential streams per thread for "
+              "multi_stream_write");
+DEFINE_uint64(duration_sec, 60, "Run time of write_timeline");
+DEFINE_double(interval_ms, 100, "Latency histogram interval of write_timeline");
+DEFINE_string(pmem_file, kPmemFile,
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram. "
+              "See utils/pmem_region.h.");
+
+/// The pmem's NUMA node, from sysfs, or from the page placement for emulated
+/// regions. -1 if unknown.
+static int pmem_numa_node = -1;
+
+/// Sweep parameters for one benchmark
+struct BenchParams {
+  std::vector<size_t> threads;  // Thread counts
+  std::vector<size_t> sizes;    // Copy sizes in bytes
+};
+
+typedef void (*bench_driver_t)(uint8_t *pbuf, const BenchParams &params,
+                               ResultWriter &writer);
+
+struct BenchInfo {
+  std::string name;
+  std::string description;
+  std::string default_threads;
+  std::string default_sizes;  // Empty if the benchmark takes no sizes
+  bench_driver_t driver;
+};
+
+// Benchmarks that take no thread count run on the main thread only
+static void assert_single_thread(const BenchParams &params) {
+  rt_assert(params.threads.size() == 1 && params.threads[0] == 1,
+            "This benchmark supports only one thread");
 }
 
-// Write to the whole buffer to "map it in", whatever that means
-void map_in_buffer_whole(uint8_t *pbuf) {
-  printf("Writing to the whole file for map-in...\n");
-  const size_t chunk_sz = GB(16);
-  rt_assert(kPmemFileSize % chunk_sz == 0, "Invalid chunk size for map-in");
+void drive_seq_write_tput(uint8_t *pbuf, const BenchParams &params,
+                          ResultWriter &writer) {
+  for (size_t num_threads : params.threads) {
+    for (size_t copy_sz : params.sizes) {
+      std::vector<double> avg_tput_GBps(num_threads);
+      std::vector<std::thread> threads(num_threads);
+      for (size_t i = 0; i < num_threads; i++) {
+        threads[i] = std::thread(bench_seq_write_tput, pbuf, i, num_threads,
+                                 copy_sz, &avg_tput_GBps[i]);
+        bind_to_core(threads[i], kNumaNode, i);
+      }
+      for (auto &t : threads) t.join();
 
-  for (size_t i = 0; i < kPmemFileSize; i += chunk_sz) {
-    struct timespec start;
-    clock_gettime(CLOCK_REALTIME, &start);
-    pmem_memset_persist(&pbuf[i], 3185, chunk_sz);  // nodrain performs similar
-    printf("Fraction complete = %.2f. Took %.3f sec for %zu GB.\n",
-           (i + 1) * 1.0 / kPmemFileSize, sec_since(start), chunk_sz / GB(1));
+      ResultRow row;
+      row.add("benchmark", "seq_write_tput").add("threads", num_threads);
+      row.add("size", copy_sz);
+      row.add("GBps", std::accumulate(avg_tput_GBps.begin(),
+                                      avg_tput_GBps.end(), 0.0));
+      writer.write(row);
+    }
   }
-
-  printf("Done writing.\n");
 }
 
-// Write to a byte in each page of the buffer, to map the pages in
-void map_in_buffer_by_page(uint8_t *pbuf) {
-  printf("Mapping-in file pages.\n");
-  struct timespec start;
-  clock_gettime(CLOCK_REALTIME, &start);
+void drive_rand_write_tput(uint8_t *pbuf, const BenchParams &params,
+                           ResultWriter &writer) {
+  for (size_t copy_sz : params.sizes) {
+    for (size_t num_threads : params.threads) {
+      std::vector<double> tput_GBps(num_threads);
+      std::vector<std::thread> threads(num_threads);
+      for (size_t i = 0; i < num_threads; i++) {
+        threads[i] = std::thread(bench_rand_write_tput, pbuf, i, copy_sz,
+                                 num_threads, &tput_GBps[i]);
+      }
+      for (auto &t : threads) t.join();
 
-  for (size_t i = 0; i < kPmemFileSize; i += KB(4)) {
-    pmem_memset_nodrain(&pbuf[i], 3185, 1);
-    if (i % GB(32) == 0 && i > 0) {
-      printf("Fraction complete = %.2f. Took %.3f sec for %u GB.\n",
-             (i + 1) * 1.0 / kPmemFileSize, sec_since(start), 32);
-      clock_gettime(CLOCK_REALTIME, &start);
+      ResultRow row;
+      row.add("benchmark", "rand_write_tput").add("threads", num_threads);
+      row.add("size", copy_sz);
+      row.add("GBps", std::accumulate(tput_GBps.begin(), tput_GBps.end(), 0.0));
+      writer.write(row);
     }
   }
-
-  printf("Done mapping-in.\n");
 }
 
-// Map pmem file in devdax mode
-uint8_t *map_pmem_file_devdax() {
-  int fd = open(kPmemFile, O_RDWR);
-  rt_assert(fd >= 0, "devdax open failed");
-  rt_assert(kPmemFileSize % MB(2) == 0, "File size must be multiple of 2 MB");
+void drive_rand_read_tput(uint8_t *pbuf, const BenchParams &params,
+                          ResultWriter &writer) {
+  for (size_t copy_sz : params.sizes) {
+    rt_assert(copy_sz == 64 || copy_sz == 256 || copy_sz == 512 ||
+                  copy_sz == 1024,
+              "rand_read_tput supports sizes 64, 256, 512 and 1024 only");
 
-  void *buf =
-      mmap(nullptr, kPmemFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  rt_assert(buf != MAP_FAILED, "mmap failed for devdax");
-  rt_assert(reinterpret_cast<size_t>(buf) % 256 == 0);
+    for (size_t num_threads : params.threads) {
+      std::vector<double> avg_mops(num_threads);
+      std::vector<size_t> sums(num_threads);
+      std::vector<std::thread> threads(num_threads);
+      for (size_t i = 0; i < num_threads; i++) {
+        threads[i] = std::thread(bench_rand_read_tput, pbuf, copy_sz,
+                                 &avg_mops[i], &sums[i]);
+      }
+      for (auto &t : threads) t.join();
 
-  return reinterpret_cast<uint8_t *>(buf);
+      double tot_mops = std::accumulate(avg_mops.begin(), avg_mops.end(), 0.0);
+      ResultRow row;
+      row.add("benchmark", "rand_read_tput").add("threads", num_threads);
+      row.add("size", copy_sz).add("Mops", tot_mops);
+      row.add("GBps", tot_mops * copy_sz / 1000);
+      row.add("sum", std::accumulate(sums.begin(), sums.end(), 0ul));
+      writer.write(row);
+    }
+  }
 }
 
-// Map pmem file in fsdax mode
-uint8_t *map_pmem_file_fsdax() {
-  uint8_t *pbuf;
-  size_t mapped_len;
-  int is_pmem;
-
-  pbuf = reinterpret_cast<uint8_t *>(pmem_map_file(
-      kPmemFile, 0 /* length */, 0 /* flags */, 0666, &mapped_len, &is_pmem));
-
-  rt_assert(pbuf != nullptr,
-            "pmem_map_file() failed. " + std::string(strerror(errno)));
-  rt_assert(mapped_len >= kPmemFileSize,
-            "pmem file too small " + std::to_string(mapped_len));
-  rt_assert(reinterpret_cast<size_t>(pbuf) % 4096 == 0,
-            "Mapped buffer isn't page-aligned");
-  rt_assert(is_pmem == 1, "File is not pmem");
-  printf("Mapped file of length %.2f GB\n", mapped_len * 1.0 / GB(1));
-
-  return pbuf;
+void drive_seq_read_tput(uint8_t *pbuf, const BenchParams &params,
+                         ResultWriter &writer) {
+  for (size_t num_threads : params.threads) {
+    std::vector<double> avg_tput_GBps(num_threads);
+    std::vector<size_t> sums(num_threads);
+    std::vector<std::thread> threads(num_threads);
+    for (size_t i = 0; i < num_threads; i++) {
+      threads[i] = std::thread(bench_seq_read_tput, pbuf, &avg_tput_GBps[i],
+                               &sums[i]);
+      bind_to_core(threads[i], kNumaNode, i);
+    }
+    for (auto &t : threads) t.join();
+
+    ResultRow row;
+    row.add("benchmark", "seq_read_tput").add("threads", num_threads);
+    row.add("GBps", std::accumulate(avg_tput_GBps.begin(),
+                                    avg_tput_GBps.end(), 0.0));
+    row.add("sum", std::accumulate(sums.begin(), sums.end(), 0ul));
+    writer.write(row);
+  }
 }
 
-int main(int argc, char **argv) {
-  gflags::ParseCommandLineFlags(&argc, &argv, true);
-  uint8_t *pbuf;
-
-  freq_ghz = measure_rdtsc_freq();
-  printf("RDTSC frequency = %.2f GHz\n", freq_ghz);
-
-  pbuf = is_pmem_file_devdax() ? map_pmem_file_devdax() : map_pmem_file_fsdax();
-
-  // Print some random file samples to check it's full of random contents
-  printf("File contents sample: ");
-  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
-  for (size_t i = 0; i < 10; i++) {
-    printf("%zu ", *reinterpret_cast<size_t *>(&pbuf[pcg() % kPmemFileSize]));
-  }
-  printf("\n");
-
-  // map_in_buffer_by_page(pbuf);
-  // map_in_buffer_whole(pbuf);
-
-  std::string bench_func;  // Last one wins
-  bench_func = "bench_seq_read_latency";
-  bench_func = "bench_rand_write_latency";
-  bench_func = "bench_rand_read_tput";
-  bench_func = "bench_seq_write_tput";
-  bench_func = "bench_seq_write_latency";
-  bench_func = "bench_rand_read_latency";
-  bench_func = "bench_seq_read_tput";
-  bench_func = "bench_rand_write_tput";
-  bench_func = "bench_seq_write_tput";
-
-  // Sequential write throughput
-  if (bench_func == "bench_seq_write_tput") {
-    printf("Sequential write throughput. %zu threads\n", FLAGS_num_threads);
-    std::ostringstream dat_header;
-    std::ostringstream dat_data;
-    dat_header << "Threads ";
-    dat_data << std::to_string(FLAGS_num_threads) << " ";
-
-    for (size_t copy_sz = MB(2); copy_sz <= GB(1); copy_sz *= 2) {
-      dat_header << std::to_string(copy_sz) << " ";
-      std::vector<double> avg_tput_GBps(FLAGS_num_threads);
-
-      std::vector<std::thread> threads(FLAGS_num_threads);
-      for (size_t i = 0; i < FLAGS_num_threads; i++) {
-        threads[i] = std::thread(bench_seq_write_tput, pbuf, i, copy_sz,
-                                 &avg_tput_GBps[i]);
-        bind_to_core(threads[i], kNumaNode, i);
-      }
-      for (auto &t : threads) t.join();
+void drive_seq_write_latency(uint8_t *pbuf, const BenchParams &params,
+                             ResultWriter &writer) {
+  assert_single_thread(params);
+  bench_seq_write_latency(pbuf, params.sizes, writer);
+}
 
-      double total_tput = 0.0;
-      for (size_t i = 0; i < FLAGS_num_threads; i++)
-        total_tput += avg_tput_GBps[i];
-      dat_data << std::setprecision(2) << total_tput << " ";
-    }
+void drive_rand_write_latency(uint8_t *pbuf, const BenchParams &params,
+                              ResultWriter &writer) {
+  assert_single_thread(params);
+  bench_rand_write_latency(pbuf, params.sizes, writer);
+}
 
-    printf("%s\n", dat_header.str().c_str());
-    printf("%s\n", dat_data.str().c_str());
-  }
+void drive_rand_read_latency(uint8_t *pbuf, const BenchParams &params,
+                             ResultWriter &writer) {
+  assert_single_thread(params);
+  bench_rand_read_latency(pbuf, params.sizes, writer);
+}
 
-  // Sequential write latency
-  if (bench_func == "bench_seq_write_latency") {
-    printf("Sequential write latency. One thread only!\n");
-    bench_seq_write_latency(pbuf);
-  }
+void drive_write_open_loop(uint8_t *pbuf, const BenchParams &params,
+                           ResultWriter &writer) {
+  assert_single_thread(params);
+  const std::vector<double> rates_mops = parse_double_list(FLAGS_rates);
 
-  // Random write latency
-  if (bench_func == "bench_rand_write_latency") {
-    printf("Random write latency. One thread only!\n");
-    bench_rand_write_latency(pbuf);
-  }
+  bench_write_open_loop(pbuf, params.sizes, rates_mops,
+                        ArrivalGenerator::parse_type(FLAGS_arrival), writer);
+}
 
-  // Random read latency
-  if (bench_func == "bench_rand_read_latency") {
-    printf("Random read latency. One thread only!\n");
-    bench_rand_read_latency(pbuf);
+/// Add p50 and p99 columns for \p latencies in cycles, or -1 if empty
+static void add_percentiles(ResultRow &row, const std::string &prefix,
+                            std::vector<size_t> &latencies) {
+  if (latencies.empty()) {
+    row.add(prefix + "_p50_ns", -1.0).add(prefix + "_p99_ns", -1.0);
+    return;
   }
+  std::sort(latencies.begin(), latencies.end());
+  row.add(prefix + "_p50_ns", latencies.at(latencies.size() / 2) / freq_ghz);
+  row.add(prefix + "_p99_ns",
+          latencies.at(latencies.size() * 99 / 100) / freq_ghz);
+}
 
-  // Random write tput
-  if (bench_func == "bench_rand_write_tput") {
-    std::vector<size_t> thread_count = {1};
-    std::vector<size_t> copy_sz_vec = {256};
-
-    for (size_t copy_sz : copy_sz_vec) {
-      for (size_t num_threads : thread_count) {
-        printf("Rand write tput with %zu threads, copy_sz %zu\n", num_threads,
-               copy_sz);
+void drive_mixed_tput(uint8_t *pbuf, const BenchParams &params,
+                      ResultWriter &writer) {
+  rt_assert(FLAGS_mixed_roles == "mixed" || FLAGS_mixed_roles == "dedicated",
+            "Invalid --mixed_roles");
+  rt_assert(FLAGS_pattern == "rand" || FLAGS_pattern == "seq",
+            "Invalid --pattern");
+  const MixedRoles roles = FLAGS_mixed_roles == "mixed"
+                               ? MixedRoles::kMixed
+                               : MixedRoles::kDedicated;
+  const std::vector<size_t> read_pcts = parse_size_list(FLAGS_read_pcts);
+
+  for (size_t copy_sz : params.sizes) {
+    for (size_t num_threads : params.threads) {
+      for (size_t read_pct : read_pcts) {
+        rt_assert(read_pct <= 100, "Invalid read percent");
+        std::vector<MixedResult> results(num_threads);
         std::vector<std::thread> threads(num_threads);
-
         for (size_t i = 0; i < num_threads; i++) {
-          threads[i] =
-              std::thread(bench_rand_write_tput, pbuf, i, copy_sz, num_threads);
+          threads[i] = std::thread(bench_mixed_tput, pbuf, i, num_threads,
+                                   copy_sz, read_pct, roles,
+                                   FLAGS_pattern == "rand", &results[i]);
+          bind_to_core(threads[i], kNumaNode, i);
+        }
+        for (auto &t : threads) t.join();
+
+        double read_GBps = 0, write_GBps = 0;
+        size_t sum = 0;
+        std::vector<size_t> read_latencies, write_latencies;
+        for (auto &r : results) {
+          read_GBps += r.read_ops * copy_sz / (r.seconds * GB(1));
+          write_GBps += r.write_ops * copy_sz / (r.seconds * GB(1));
+          sum += r.sum;
+          read_latencies.insert(read_latencies.end(), r.read_latencies.begin(),
+                                r.read_latencies.end());
+          write_latencies.insert(write_latencies.end(),
+                                 r.write_latencies.begin(),
+                                 r.write_latencies.end());
         }
 
-        for (size_t i = 0; i < num_threads; i++) threads[i].join();
+        ResultRow row;
+        row.add("benchmark", "mixed_tput").add("threads", num_threads);
+        row.add("size", copy_sz).add("read_pct", read_pct);
+        row.add("roles", FLAGS_mixed_roles).add("pattern", FLAGS_pattern);
+        row.add("read_GBps", read_GBps).add("write_GBps", write_GBps);
+        add_percentiles(row, "read", read_latencies);
+        add_percentiles(row, "write", write_latencies);
+        row.add("sum", sum);
+        writer.write(row);
       }
     }
   }
+}
 
-  // Random read throughput
-  if (bench_func == "bench_rand_read_tput") {
-    std::vector<size_t> thread_count = {1, 2, 4, 8, 16, 24, 48};
-    std::vector<size_t> copy_sz_vec = {64, 256, 512, 1024};
+void drive_copy_kernels(uint8_t *pbuf, const BenchParams &params,
+                        ResultWriter &writer) {
+  assert_single_thread(params);
+  bench_copy_kernels(pbuf, params.sizes, writer);
+}
 
-    for (size_t copy_sz : copy_sz_vec) {
-      for (size_t num_threads : thread_count) {
-        printf("Rand read tput with %zu threads, copy_sz %zu\n", num_threads,
-               copy_sz);
+void drive_multi_stream_write(uint8_t *pbuf, const BenchParams &params,
+                              ResultWriter &writer) {
+  const std::vector<size_t> streams_vec = parse_size_list(FLAGS_streams);
+  for (size_t copy_sz : params.sizes) {
+    for (size_t num_threads : params.threads) {
+      for (size_t num_streams : streams_vec) {
+        std::vector<double> tput_GBps(num_threads);
         std::vector<std::thread> threads(num_threads);
-
         for (size_t i = 0; i < num_threads; i++) {
           threads[i] =
-              std::thread(bench_rand_read_tput, pbuf, i, copy_sz, num_threads);
+              std::thread(bench_multi_stream_write, pbuf, i, num_threads,
+                          copy_sz, num_streams, &tput_GBps[i]);
+          bind_to_core(threads[i], kNumaNode, i);
         }
-
-        for (size_t i = 0; i < num_threads; i++) threads[i].join();
+        for (auto &t : threads) t.join();
+
+        ResultRow row;
+        row.add("benchmark", "multi_stream_write").add("threads", num_threads);
+        row.add("size", copy_sz).add("streams_per_thread", num_streams);
+        row.add("total_streams", num_threads * num_streams);
+        row.add("GBps",
+                std::accumulate(tput_GBps.begin(), tput_GBps.end(), 0.0));
+        writer.write(row);
       }
     }
   }
+}
 
-  // Sequential read throughput
-  if (bench_func == "bench_seq_read_tput") {
-    std::vector<size_t> thread_count = {1, 2, 4, 8, 16, 24, 48};
-
-    for (size_t num_threads : thread_count) {
-      printf("Seq read tput with %zu threads\n", num_threads);
+void drive_write_timeline(uint8_t *pbuf, const BenchParams &params,
+                          ResultWriter &writer) {
+  rt_assert(FLAGS_pattern == "rand" || FLAGS_pattern == "seq",
+            "Invalid --pattern");
+  for (size_t copy_sz : params.sizes) {
+    for (size_t num_threads : params.threads) {
+      // All threads share interval boundaries, so their rows line up
+      const size_t start_tsc = rdtsc();
+      std::vector<LatencyTimeline> timelines(
+          num_threads, LatencyTimeline(freq_ghz, FLAGS_interval_ms, start_tsc));
       std::vector<std::thread> threads(num_threads);
-
       for (size_t i = 0; i < num_threads; i++) {
-        threads[i] = std::thread(bench_seq_read_tput, pbuf, i, num_threads);
+        threads[i] = std::thread(bench_write_timeline, pbuf, i, num_threads,
+                                 copy_sz, FLAGS_pattern == "rand",
+                                 FLAGS_duration_sec, &timelines[i]);
         bind_to_core(threads[i], kNumaNode, i);
       }
+      for (auto &t : threads) t.join();
 
-      for (size_t i = 0; i < num_threads; i++) threads[i].join();
+      for (size_t i = 0; i < num_threads; i++) {
+        ResultRow prefix;
+        prefix.add("benchmark", "write_timeline").add("threads", num_threads);
+        prefix.add("size", copy_sz).add("pattern", FLAGS_pattern);
+        prefix.add("thread", i);
+        timelines[i].write_rows(writer, prefix);
+      }
     }
   }
+}
+
+void drive_numa_sweep(uint8_t *pbuf, const BenchParams &params,
+                      ResultWriter &writer) {
+  bench_numa_sweep(pbuf, params.threads, params.sizes, pmem_numa_node, writer);
+}
+
+void drive_handoff_latency(uint8_t *pbuf, const BenchParams &params,
+                           ResultWriter &writer) {
+  if (params.threads != std::vector<size_t>{2}) {
+    fprintf(stderr, "handoff_latency always uses two threads. "
+                    "Ignoring --threads.\n");
+  }
+  const size_t numa_node =
+      pmem_numa_node >= 0 ? get_nearest_cpu_node(pmem_numa_node) : kNumaNode;
+  if (get_lcores_for_numa_node(numa_node).size() < 2) {
+    fprintf(stderr,
+            "Skipping handoff_latency: NUMA node %zu has fewer than two "
+            "cores.\n",
+            numa_node);
+    return;
+  }
+  bench_handoff_latency(pbuf, params.sizes, numa_node, writer);
+}
+
+/// All benchmarks, in the order that "all" runs them
+static const std::vector<BenchInfo> kBenchRegistry = {
+    {"seq_write_tput", "Sequential persistent write throughput", "1",
+     "2M,4M,8M,16M,32M,64M,128M,256M,512M,1G", drive_seq_write_tput},
+    {"seq_write_latency", "Sequential persistent write latency", "1",
+     "64,128,256,512,1K,2K,4K,8K,16K,32K,64K", drive_seq_write_latency},
+    {"rand_write_tput", "Random persistent write throughput", "1", "256",
+     drive_rand_write_tput},
+    {"rand_write_latency", "Random persistent write latency", "1",
+     "64,128,256,512,1K,2K,4K,8K,16K,32K,64K", drive_rand_write_latency},
+    {"seq_read_tput", "Sequential read throughput with memcpy",
+     "1,2,4,8,16,24,48", "", drive_seq_read_tput},
+    {"rand_read_tput", "Random read throughput", "1,2,4,8,16,24,48",
+     "64,256,512,1024", drive_rand_read_tput},
+    {"rand_read_latency", "Random read latency", "1",
+     "64,128,256,512,1K,2K,4K,8K,16K,32K,64K", drive_rand_read_latency},
+    {"mixed_tput", "Mixed read and persistent write throughput",
+     "1,2,4,8,16", "256", drive_mixed_tput},
+    {"copy_kernels", "Persistent copy with libpmem vs. in-repo SIMD kernels",
+     "1", "64,128,256,512,1K,4K,16K,64K,256K,1M", drive_copy_kernels},
+    {"multi_stream_write",
+     "Sequential persistent write throughput with many streams per thread",
+     "1,2,4,8", "256", drive_multi_stream_write},
+    {"write_open_loop", "Open-loop random write latency at offered loads",
+     "1", "64,256,1K", drive_write_open_loop},
+    {"write_timeline",
+     "Persistent write latency percentiles per time interval, to find stalls",
+     "1", "256", drive_write_timeline},
+    {"handoff_latency",
+     "One-way latency of a persisted payload and flag to a reader on another "
+     "core, vs. DRAM",
+     "2", "64,256,1K,4K", drive_handoff_latency},
+    {"numa_sweep", "Read, write, and mixed throughput by thread NUMA node",
+     "1,4", "256", drive_numa_sweep},
+};
+
+static const BenchInfo &get_bench_info(const std::string &name) {
+  for (auto &info : kBenchRegistry) {
+    if (info.name == name) return info;
+  }
+  throw std::runtime_error("Unknown benchmark " + name + ". See --list.");
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_list) {
+    printf("name: description [default threads] [default sizes]\n");
+    for (auto &info : kBenchRegistry) {
+      printf("%s: %s [%s] [%s]\n", info.name.c_str(), info.description.c_str(),
+             info.default_threads.c_str(), info.default_sizes.c_str());
+    }
+    exit(0);
+  }
+
+  // Resolve the benchmarks before the slow mapping, to fail fast
+  std::vector<const BenchInfo *> bench_vec;
+  if (FLAGS_benchmark == "all") {
+    for (auto &info : kBenchRegistry) bench_vec.push_back(&info);
+  } else {
+    for (const std::string &name : parse_str_list(FLAGS_benchmark)) {
+      bench_vec.push_back(&get_bench_info(name));
+    }
+  }
+
+  ResultWriter writer(FLAGS_format, FLAGS_output_file);
+  freq_ghz = measure_rdtsc_freq();
+  fprintf(stderr, "RDTSC frequency = %.2f GHz\n", freq_ghz);
+
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, kPmemFileSize);
+  uint8_t *pbuf = region.buf;
+  fprintf(stderr, "Mapped %s region of length %.2f GB\n",
+          pmem_backend_str(region.backend), region.len * 1.0 / GB(1));
+
+  pmem_numa_node = get_pmem_numa_node(FLAGS_pmem_file);
+  if (pmem_numa_node < 0 && region.is_emulated()) {
+    pmem_memset_persist(pbuf, 0, 1);  // Fault in the first page to locate it
+    pmem_numa_node = get_addr_numa_node(pbuf);
+  }
+
+  // Print some random file samples to check it's full of random contents
+  fprintf(stderr, "File contents sample: ");
+  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+  for (size_t i = 0; i < 10; i++) {
+    fprintf(stderr, "%zu ",
+            *reinterpret_cast<size_t *>(&pbuf[pcg() % kPmemFileSize]));
+  }
+  fprintf(stderr, "\n");
+
+  ResultRow metadata;
+  metadata.add("pmem_file", FLAGS_pmem_file);
+  metadata.add("pmem_file_size", kPmemFileSize);
+  metadata.add("pmem_mode", pmem_backend_str(region.backend));
+  metadata.add("pmem_numa_node", std::to_string(pmem_numa_node));
+  metadata.add("rdtsc_freq_ghz", freq_ghz);
+  writer.write_metadata(metadata);
+
+  for (const BenchInfo *info : bench_vec) {
+    BenchParams params;
+    params.threads = parse_size_list(
+        FLAGS_threads.empty() ? info->default_threads : FLAGS_threads);
+    params.sizes = parse_size_list(FLAGS_sizes.empty() ? info->default_sizes
+                                                       : FLAGS_sizes);
+    if (!info->default_sizes.empty()) {
+      rt_assert(!params.sizes.empty(), "No sizes for " + info->name);
+    }
+
+    fprintf(stderr, "Running %s\n", info->name.c_str());
+    info->driver(pbuf, params, writer);
+  }
 
-  is_pmem_file_devdax() ? munmap(pbuf, kPmemFileSize)
-                        : pmem_unmap(pbuf, kPmemFileSize);
+  unmap_pmem_region(region);
   exit(0);
 }
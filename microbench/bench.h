@@ -16,16 +16,22 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <algorithm>
+#include <atomic>
 #include <iomanip>
+#include <numeric>
 #include <pcg/pcg_random.hpp>
 #include <sstream>
 #include <thread>
+#include <vector>
 
 #include "../common.h"
+#include "../utils/parse_list.h"
+#include "../utils/pmem_region.h"
+#include "../utils/result_writer.h"
 #include "../utils/timer.h"
 
-DEFINE_uint64(num_threads, 0, "Number of threads");
-
+// The default --pmem_file
 // static constexpr const char *kPmemFile = "/mnt/pmem12/raft_log";
 static constexpr const char *kPmemFile = "/dev/dax0.0";
 
@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "../utils/pmem_copy.h"
+
+/// A persistent copy kernel under test
+struct CopyKernel {
+  const char *name;
+  pmem_copy::CopyFunc func;  // Copies without a fence
+  bool supported;
+};
+
+static void copy_kernel_libpmem(void *dst, const void *src, size_t len) {
+  pmem_memcpy_nodrain(dst, src, len);
+}
+
+/**
+ * @brief Persistent copy throughput and latency of libpmem and the in-repo
+ * SIMD kernels, to random cacheline-aligned offsets. Each copy is followed by
+ * an sfence. Kernels that this CPU doesn't support are skipped.
+ */
+void bench_copy_kernels(uint8_t *pbuf, const std::vector<size_t> &sizes,
+                        ResultWriter &writer) {
+  using pmem_copy::Isa;
+  using pmem_copy::copy_nt_nodrain;
+  static constexpr size_t kCopyBytes = MB(256);
+  static constexpr size_t kMinIters = 100000;
+
+  const CpuFeatures features = get_cpu_features();
+  const std::vector<CopyKernel> kernels = {
+      {"libpmem", copy_kernel_libpmem, true},
+      {"clwb", pmem_copy::copy_clwb_nodrain, true},
+      {"simd", SimdCopy::copy_nodrain, true},
+      {"avx2_u1", copy_nt_nodrain<Isa::kAvx2, 1, false>, features.avx2},
+      {"avx2_u4", copy_nt_nodrain<Isa::kAvx2, 4, false>, features.avx2},
+      {"avx2_u4_loads_first", copy_nt_nodrain<Isa::kAvx2, 4, true>,
+       features.avx2},
+      {"avx512_u1", copy_nt_nodrain<Isa::kAvx512, 1, false>, features.avx512f},
+      {"avx512_u4", copy_nt_nodrain<Isa::kAvx512, 4, false>, features.avx512f},
+      {"avx512_u4_loads_first", copy_nt_nodrain<Isa::kAvx512, 4, true>,
+       features.avx512f},
+      {"avx512_u8_loads_first", copy_nt_nodrain<Isa::kAvx512, 8, true>,
+       features.avx512f}};
+
+  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+  const size_t max_size = *std::max_element(sizes.begin(), sizes.end());
+  auto *src = static_cast<uint8_t *>(memalign(4096, max_size));
+  memset(src, 31, max_size);
+
+  for (size_t size : sizes) {
+    const size_t num_iters = std::max(kMinIters, kCopyBytes / size);
+    for (const CopyKernel &kernel : kernels) {
+      if (!kernel.supported) continue;
+
+      size_t tot_cycles = 0;
+      for (size_t i = 0; i < num_iters; i++) {
+        const size_t offset = roundup<64>(pcg() % (kPmemFileSize - size - 64));
+        src[0]++;
+
+        const size_t start_tsc = timer::Start();
+        kernel.func(&pbuf[offset], src, size);
+        sfence();
+        emul_persist_delay(size);
+        tot_cycles += timer::Stop() - start_tsc;
+      }
+
+      const double avg_ns = tot_cycles / (num_iters * freq_ghz);
+      ResultRow row;
+      row.add("benchmark", "copy_kernels").add("kernel", kernel.name);
+      row.add("size", size).add("avg_ns", avg_ns);
+      row.add("GBps", size / avg_ns);
+      writer.write(row);
+    }
+  }
+
+  free(src);
+}
@@ -0,0 +1,228 @@
+#include "bench.h"
+#include "../utils/cpuid.h"
+
+/// How the handoff writer makes its lines durable
+enum class HandoffMethod { kStore, kNtStore, kClwb, kClflushopt, kClflush };
+
+static const char *handoff_method_str(HandoffMethod method) {
+  switch (method) {
+    case HandoffMethod::kStore:
+      return "store";
+    case HandoffMethod::kNtStore:
+      return "ntstore";
+    case HandoffMethod::kClwb:
+      return "clwb";
+    case HandoffMethod::kClflushopt:
+      return "clflushopt";
+    case HandoffMethod::kClflush:
+      return "clflush";
+  }
+  return "invalid";
+}
+
+__attribute__((target("clwb"))) static void handoff_clwb(void *line) {
+  _mm_clwb(line);
+}
+
+__attribute__((target("clflushopt"))) static void handoff_clflushopt(
+    void *line) {
+  _mm_clflushopt(line);
+}
+
+/// Write one cacheline from \p src to \p dst and flush it, without a fence
+static inline void handoff_write_line(HandoffMethod method, uint8_t *dst,
+                                      const uint8_t *src) {
+  if (method == HandoffMethod::kNtStore) {
+    for (size_t i = 0; i < 64; i += 16) {
+      const __m128i v =
+          _mm_load_si128(reinterpret_cast<const __m128i *>(src + i));
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+    return;
+  }
+
+  memcpy(dst, src, 64);
+  switch (method) {
+    case HandoffMethod::kClwb:
+      handoff_clwb(dst);
+      break;
+    case HandoffMethod::kClflushopt:
+      handoff_clflushopt(dst);
+      break;
+    case HandoffMethod::kClflush:
+      _mm_clflush(dst);
+      break;
+    default:
+      break;
+  }
+}
+
+/// Make the preceding writes durable and ordered before later ones. Plain
+/// stores need only a compiler barrier, since x86 doesn't reorder stores.
+static inline void handoff_fence(HandoffMethod method) {
+  if (method == HandoffMethod::kStore) {
+    asm volatile("" ::: "memory");
+  } else {
+    sfence();
+  }
+}
+
+/// Per-handoff latencies in cycles
+struct HandoffResult {
+  std::vector<size_t> persist_cycles;  // Writer: payload and flag persisted
+  std::vector<size_t> oneway_cycles;   // Writer start to reader's payload read
+  size_t stale_lines = 0;  // Payload lines the reader saw before the write
+};
+
+/**
+ * @brief The writer side of a handoff ping-pong. Handoff i persists a \p size
+ * byte payload into ring slot i, then a flag line after it, and waits for the
+ * reader's ack before the next handoff.
+ *
+ * Every payload line starts with the handoff's sequence number and the
+ * writer's start TSC.
+ */
+void handoff_writer(uint8_t *ring, size_t num_slots, size_t size,
+                    HandoffMethod method, bool is_pmem, size_t num_handoffs,
+                    std::atomic<size_t> *ack, HandoffResult *result) {
+  const size_t slot_size = size + 64;
+  auto *src = static_cast<uint8_t *>(memalign(64, slot_size));
+  memset(src, 31, slot_size);
+  auto *src_words = reinterpret_cast<size_t *>(src);
+
+  for (size_t seq = 1; seq <= num_handoffs; seq++) {
+    uint8_t *slot = &ring[(seq % num_slots) * slot_size];
+    const size_t start_tsc = rdtsc();
+    for (size_t i = 0; i < slot_size; i += 64) {
+      src_words[i / 8] = seq;
+      src_words[i / 8 + 1] = start_tsc;
+    }
+
+    for (size_t i = 0; i < size; i += 64) {
+      handoff_write_line(method, &slot[i], &src[i]);
+    }
+    handoff_fence(method);
+    if (is_pmem) emul_persist_delay(size);
+
+    handoff_write_line(method, &slot[size], &src[size]);
+    handoff_fence(method);
+    if (is_pmem) emul_persist_delay(64);
+    result->persist_cycles.push_back(rdtsc() - start_tsc);
+
+    while (ack->load(std::memory_order_acquire) != seq) _mm_pause();
+  }
+
+  free(src);
+}
+
+/// The reader side of a handoff ping-pong: spin on each slot's flag line,
+/// then read and check the payload, then ack
+void handoff_reader(uint8_t *ring, size_t num_slots, size_t size,
+                    size_t num_handoffs, std::atomic<size_t> *ack,
+                    HandoffResult *result) {
+  const size_t slot_size = size + 64;
+
+  for (size_t seq = 1; seq <= num_handoffs; seq++) {
+    uint8_t *slot = &ring[(seq % num_slots) * slot_size];
+    auto *flag = reinterpret_cast<volatile size_t *>(&slot[size]);
+    while (*flag != seq) _mm_pause();
+
+    for (size_t i = 0; i < size; i += 64) {
+      auto *line = reinterpret_cast<volatile size_t *>(&slot[i]);
+      if (line[0] != seq) result->stale_lines++;
+    }
+    const size_t start_tsc = *reinterpret_cast<volatile size_t *>(slot + 8);
+    result->oneway_cycles.push_back(rdtsc() - start_tsc);
+
+    ack->store(seq, std::memory_order_release);
+  }
+}
+
+/**
+ * @brief One-way latency of a producer-consumer handoff through pmem and
+ * through DRAM: how soon a reader on another core sees a payload after the
+ * writer persists it and then a flag.
+ *
+ * Two threads on \p numa_node ping-pong over a ring of slots, for each payload
+ * size in \p sizes and each persistence method that the CPU supports. One-way
+ * latency is from the writer's first store to the reader's payload read. It
+ * relies on the TSC being synchronized across cores.
+ */
+void bench_handoff_latency(uint8_t *pbuf, const std::vector<size_t> &sizes,
+                           size_t numa_node, ResultWriter &writer) {
+  static constexpr size_t kRingSize = MB(1);
+  static constexpr size_t kWarmupHandoffs = 1000;
+  static constexpr size_t kHandoffs = 100000;
+
+  rt_assert(get_lcores_for_numa_node(numa_node).size() >= 2,
+            "handoff_latency needs two cores on the NUMA node");
+  const CpuFeatures features = get_cpu_features();
+  std::vector<HandoffMethod> methods = {HandoffMethod::kStore,
+                                        HandoffMethod::kNtStore};
+  if (features.clwb) methods.push_back(HandoffMethod::kClwb);
+  if (features.clflushopt) methods.push_back(HandoffMethod::kClflushopt);
+  if (features.clflush) methods.push_back(HandoffMethod::kClflush);
+
+  auto *dram_ring = static_cast<uint8_t *>(memalign(4096, kRingSize));
+  memset(dram_ring, 0, kRingSize);
+  pmem_memset_persist(pbuf, 0, kRingSize);
+
+  for (size_t size : sizes) {
+    rt_assert(size >= 64 && size % 64 == 0 && size + 64 <= kRingSize,
+              "handoff_latency sizes must be multiples of 64 up to 1 MB");
+    const size_t num_slots = kRingSize / (size + 64);
+
+    for (bool is_pmem : {true, false}) {
+      uint8_t *ring = is_pmem ? pbuf : dram_ring;
+      for (HandoffMethod method : methods) {
+        const size_t num_handoffs = kWarmupHandoffs + kHandoffs;
+        HandoffResult writer_result, reader_result;
+        writer_result.persist_cycles.reserve(num_handoffs);
+        reader_result.oneway_cycles.reserve(num_handoffs);
+
+        // Zero the flags, so that stale flags from the last run don't match
+        for (size_t s = 0; s < num_slots; s++) {
+          pmem_memset_persist(&ring[s * (size + 64) + size], 0, 64);
+        }
+
+        std::atomic<size_t> ack(0);
+        std::thread reader_thread(handoff_reader, ring, num_slots, size,
+                                  num_handoffs, &ack, &reader_result);
+        bind_to_core(reader_thread, numa_node, 1);
+        std::thread writer_thread(handoff_writer, ring, num_slots, size,
+                                  method, is_pmem, num_handoffs, &ack,
+                                  &writer_result);
+        bind_to_core(writer_thread, numa_node, 0);
+        writer_thread.join();
+        reader_thread.join();
+
+        std::vector<size_t> persist(
+            writer_result.persist_cycles.begin() + kWarmupHandoffs,
+            writer_result.persist_cycles.end());
+        std::vector<size_t> oneway(
+            reader_result.oneway_cycles.begin() + kWarmupHandoffs,
+            reader_result.oneway_cycles.end());
+        std::sort(persist.begin(), persist.end());
+        std::sort(oneway.begin(), oneway.end());
+
+        ResultRow row;
+        row.add("benchmark", "handoff_latency");
+        row.add("memory", is_pmem ? "pmem" : "dram");
+        row.add("method", handoff_method_str(method)).add("size", size);
+        row.add("persist_p50_ns", persist.at(persist.size() / 2) / freq_ghz);
+        row.add("oneway_avg_ns",
+                std::accumulate(oneway.begin(), oneway.end(), 0.0) /
+                    (oneway.size() * freq_ghz));
+        row.add("oneway_p50_ns", oneway.at(oneway.size() / 2) / freq_ghz);
+        row.add("oneway_p99_ns",
+                oneway.at(oneway.size() * 99 / 100) / freq_ghz);
+        row.add("oneway_p999_ns",
+                oneway.at(oneway.size() * 999 / 1000) / freq_ghz);
+        row.add("stale_lines", reader_result.stale_lines);
+        writer.write(row);
+      }
+    }
+  }
+
+  free(dram_ring);
+}
@@ -0,0 +1,96 @@
+#include "bench.h"
+
+/// How threads split reads and writes in bench_mixed_tput
+enum class MixedRoles {
+  kMixed,     // Every thread mixes reads and writes
+  kDedicated  // Each thread only reads or only writes
+};
+
+/// Per-thread results of bench_mixed_tput
+struct MixedResult {
+  size_t read_ops = 0;
+  size_t write_ops = 0;
+  double seconds = 0;
+  std::vector<size_t> read_latencies;  // Sampled, in cycles
+  std::vector<size_t> write_latencies;
+  size_t sum = 0;  // Prevents reads from being optimized out
+};
+
+// Latencies kept per op type per thread. Longer runs are sampled down to this.
+static constexpr size_t kMaxMixedLatencySamples = 100000;
+
+/// Record \p cycles as latency number \p op_num (from one) in \p samples,
+/// which must have kMaxMixedLatencySamples reserved. Reservoir sampling keeps
+/// a uniform sample without growing the vector in the timed loop.
+static inline void sample_latency(std::vector<size_t> &samples, size_t op_num,
+                                  size_t cycles, pcg64_fast &pcg) {
+  if (samples.size() < kMaxMixedLatencySamples) {
+    samples.push_back(cycles);
+    return;
+  }
+  const size_t i = pcg() % op_num;
+  if (i < kMaxMixedLatencySamples) samples[i] = cycles;
+}
+
+/**
+ * @brief Read and persistently write \p copy_sz bytes in this thread's part
+ * of the file for a fixed duration
+ *
+ * @param read_pct The percent of reads. With kMixed roles, each op is a read
+ * with this probability. With kDedicated roles, this percent of threads are
+ * readers.
+ * @param random Random offsets if true, else sequential
+ */
+void bench_mixed_tput(uint8_t *pbuf, size_t thread_id, size_t num_threads,
+                      size_t copy_sz, size_t read_pct, MixedRoles roles,
+                      bool random, MixedResult *result) {
+  static constexpr double kRunSec = 2.0;
+  static constexpr size_t kOpsPerTimeCheck = 1024;
+
+  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+  const size_t part_size = kPmemFileSize / num_threads;
+  const size_t num_slots = part_size / copy_sz;
+  uint8_t *part = &pbuf[thread_id * part_size];
+  auto *dram_buf = static_cast<uint8_t *>(memalign(4096, copy_sz));
+  memset(dram_buf, 31, copy_sz);
+
+  // With dedicated roles, threads [0, num_readers) read
+  const size_t num_readers = (num_threads * read_pct + 50) / 100;
+  const bool is_reader = thread_id < num_readers;
+
+  result->read_latencies.reserve(kMaxMixedLatencySamples);
+  result->write_latencies.reserve(kMaxMixedLatencySamples);
+
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  size_t slot = 0;
+  while (true) {
+    for (size_t i = 0; i < kOpsPerTimeCheck; i++) {
+      slot = random ? pcg() % num_slots : (slot + 1) % num_slots;
+      uint8_t *addr = &part[slot * copy_sz];
+      const bool is_read = roles == MixedRoles::kMixed ? pcg() % 100 < read_pct
+                                                       : is_reader;
+
+      const size_t start_tsc = timer::Start();
+      if (is_read) {
+        for (size_t cl = 0; cl < copy_sz; cl += 64) result->sum += addr[cl];
+        const size_t cycles = timer::Stop() - start_tsc;
+        result->read_ops++;
+        sample_latency(result->read_latencies, result->read_ops, cycles, pcg);
+      } else {
+        dram_buf[0]++;
+        pmem_memcpy_persist(addr, dram_buf, copy_sz);
+        emul_persist_delay(copy_sz);
+        const size_t cycles = timer::Stop() - start_tsc;
+        result->write_ops++;
+        sample_latency(result->write_latencies, result->write_ops, cycles,
+                       pcg);
+      }
+    }
+
+    result->seconds = sec_since(start);
+    if (result->seconds >= kRunSec) break;
+  }
+
+  free(dram_buf);
+}
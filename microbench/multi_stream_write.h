@@ -0,0 +1,46 @@
+#include "bench.h"
+
+/**
+ * @brief Persistently write \p copy_sz chunks round-robin over \p num_streams
+ * independent sequential streams in this thread's part of the file
+ *
+ * Each stream owns an equal slice of the thread's part, starts at a random
+ * offset in it, and wraps around at its end.
+ */
+void bench_multi_stream_write(uint8_t *pbuf, size_t thread_id,
+                              size_t num_threads, size_t copy_sz,
+                              size_t num_streams, double *tput_GBps) {
+  static constexpr size_t kCopyPerThread = GB(1);
+
+  const size_t part_size = kPmemFileSize / num_threads;
+  const size_t stream_size = part_size / num_streams / 256 * 256;
+  rt_assert(stream_size >= 2 * copy_sz, "Too many streams for the file");
+
+  void *dram_src_buf = memalign(4096, copy_sz);
+  memset(dram_src_buf, 0, copy_sz);
+
+  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+  std::vector<size_t> stream_base(num_streams), stream_offset(num_streams);
+  for (size_t s = 0; s < num_streams; s++) {
+    stream_base[s] = thread_id * part_size + s * stream_size;
+    stream_offset[s] = (pcg() % (stream_size - copy_sz)) / 256 * 256;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+
+  size_t s = 0;
+  for (size_t i = 0; i < kCopyPerThread / copy_sz; i++) {
+    pmem_memmove_persist(&pbuf[stream_base[s] + stream_offset[s]],
+                         dram_src_buf, copy_sz);
+    emul_persist_delay(copy_sz);
+    stream_offset[s] += copy_sz;
+    if (stream_offset[s] + copy_sz > stream_size) stream_offset[s] = 0;
+
+    s++;
+    if (s == num_streams) s = 0;
+  }
+
+  *tput_GBps = kCopyPerThread / (sec_since(start) * 1000000000);
+  free(dram_src_buf);
+}
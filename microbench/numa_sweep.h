@@ -0,0 +1,102 @@
+#include "bench.h"
+#include "../utils/numa_topology.h"
+
+/**
+ * @brief Measure reads, writes, and a 50/50 mix with threads on each NUMA
+ * node in turn, and with threads interleaved across all nodes. Nodes without
+ * CPUs, such as a devdax target_node, are skipped.
+ *
+ * @param pmem_node The pmem's NUMA node, or -1 if unknown, which makes the
+ * distance column -1
+ */
+void bench_numa_sweep(uint8_t *pbuf, const std::vector<size_t> &thread_counts,
+                      const std::vector<size_t> &sizes, int pmem_node,
+                      ResultWriter &writer) {
+  // The nodes with CPUs, and their lcore counts, which may differ
+  std::vector<size_t> cpu_nodes, node_lcores;
+  for (size_t node = 0; node <= static_cast<size_t>(numa_max_node()); node++) {
+    const size_t num_lcores = get_lcores_for_numa_node(node).size();
+    if (num_lcores == 0) continue;
+    cpu_nodes.push_back(node);
+    node_lcores.push_back(num_lcores);
+  }
+  const size_t num_nodes = cpu_nodes.size();
+
+  // Thread placements: one per node, then interleaved, which places thread i
+  // on cpu_nodes[i % num_nodes]
+  static constexpr size_t kInterleaved = SIZE_MAX;
+  std::vector<size_t> placements;
+  for (size_t node_idx = 0; node_idx < num_nodes; node_idx++) {
+    placements.push_back(node_idx);
+  }
+  if (num_nodes > 1) placements.push_back(kInterleaved);
+
+  for (size_t placement : placements) {
+    const bool interleaved = placement == kInterleaved;
+    const std::string thread_node =
+        interleaved ? "interleaved" : std::to_string(cpu_nodes[placement]);
+
+    // The node and node-local core of thread i
+    auto thread_node_idx = [&](size_t i) {
+      return interleaved ? i % num_nodes : placement;
+    };
+    auto thread_lcore = [&](size_t i) {
+      return interleaved ? i / num_nodes : i;
+    };
+
+    for (size_t num_threads : thread_counts) {
+      bool fits = true;
+      for (size_t i = 0; i < num_threads; i++) {
+        if (thread_lcore(i) >= node_lcores[thread_node_idx(i)]) fits = false;
+      }
+      if (!fits) continue;
+
+      for (size_t copy_sz : sizes) {
+        for (size_t read_pct : {100ul, 0ul, 50ul}) {
+          std::vector<MixedResult> results(num_threads);
+          std::vector<std::thread> threads(num_threads);
+          for (size_t i = 0; i < num_threads; i++) {
+            threads[i] = std::thread(bench_mixed_tput, pbuf, i, num_threads,
+                                     copy_sz, read_pct, MixedRoles::kMixed,
+                                     true /* random */, &results[i]);
+            bind_to_core(threads[i], cpu_nodes[thread_node_idx(i)],
+                         thread_lcore(i));
+          }
+          for (auto &t : threads) t.join();
+
+          // The mean thread-to-pmem distance, which is fractional when
+          // interleaved
+          double distance = 0;
+          for (size_t i = 0; i < num_threads; i++) {
+            const size_t node = cpu_nodes[thread_node_idx(i)];
+            distance += get_numa_distance(static_cast<int>(node), pmem_node);
+          }
+          distance /= num_threads;
+
+          double GBps = 0;
+          std::vector<size_t> latencies;
+          for (auto &r : results) {
+            GBps += (r.read_ops + r.write_ops) * copy_sz / (r.seconds * GB(1));
+            latencies.insert(latencies.end(), r.read_latencies.begin(),
+                             r.read_latencies.end());
+            latencies.insert(latencies.end(), r.write_latencies.begin(),
+                             r.write_latencies.end());
+          }
+          std::sort(latencies.begin(), latencies.end());
+
+          ResultRow row;
+          row.add("benchmark", "numa_sweep");
+          row.add("thread_node", thread_node);
+          row.add("pmem_node", std::to_string(pmem_node));
+          row.add("distance", distance);
+          row.add("threads", num_threads).add("size", copy_sz);
+          row.add("read_pct", read_pct).add("GBps", GBps);
+          row.add("p50_ns", latencies.at(latencies.size() / 2) / freq_ghz);
+          row.add("p99_ns",
+                  latencies.at(latencies.size() * 99 / 100) / freq_ghz);
+          writer.write(row);
+        }
+      }
+    }
+  }
+}
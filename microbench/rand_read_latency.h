@@ -1,13 +1,13 @@
 #include "bench.h"
 
-void bench_rand_read_latency(uint8_t *pbuf) {
+void bench_rand_read_latency(uint8_t *pbuf, const std::vector<size_t> &sizes,
+                             ResultWriter &writer) {
   double freq_ghz = measure_rdtsc_freq();
 
   static constexpr bool kMeasurePercentiles = false;
   static constexpr size_t kReadBytes = MB(128);
   static constexpr size_t kMinIters = 50000;
   static constexpr size_t kMinReadSz = 64;
-  static constexpr size_t kMaxReadSz = KB(64);
 
   size_t file_offset = 0;
   pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
@@ -19,10 +19,8 @@ void bench_rand_read_latency(uint8_t *pbuf) {
   size_t sum = 0;
 
   for (size_t msr = 0; msr < 10; msr++) {
-    printf("size avg_ns 50_ns 999_ns\n");
-    std::ostringstream verify_tsc_str;  // Compare tsc results with realtime
-
-    for (size_t size = kMinReadSz; size <= kMaxReadSz; size *= 2) {
+    for (size_t size : sizes) {
+      rt_assert(size >= kMinReadSz, "Read size too small");
       struct timespec start_time;
       clock_gettime(CLOCK_REALTIME, &start_time);
 
@@ -45,27 +43,23 @@ void bench_rand_read_latency(uint8_t *pbuf) {
         }
       }
 
-      size_t ns_avg_realtime = ns_since(start_time) / num_iters;
+      ResultRow row;
+      row.add("benchmark", "rand_read_latency").add("msr", msr);
+      row.add("size", size).add("avg_ns", ns_since(start_time) / num_iters);
 
+      // The rdtsc average verifies the timer's fences against realtime
       if (kMeasurePercentiles) {
         std::sort(latency_vec.begin(), latency_vec.end());
-        printf("%zu %zu %.1f %.1f\n", size, ns_avg_realtime,
-               latency_vec.at(num_iters * .50) / freq_ghz,
-               latency_vec.at(num_iters * .999) / freq_ghz);
-
-        size_t ns_avg_rdtsc =
-            std::accumulate(latency_vec.begin(), latency_vec.end(), 0.0) /
-            (latency_vec.size() * freq_ghz);
-        verify_tsc_str << size << ": Average latency (ns) " << ns_avg_realtime
-                       << " (realtime) " << ns_avg_rdtsc << " (rdtsc) "
-                       << (ns_avg_realtime - ns_avg_rdtsc) << " (delta) "
-                       << "\n";
+        row.add("avg_rdtsc_ns",
+                std::accumulate(latency_vec.begin(), latency_vec.end(), 0.0) /
+                    (latency_vec.size() * freq_ghz));
+        row.add("p50_ns", latency_vec.at(num_iters * .50) / freq_ghz);
+        row.add("p999_ns", latency_vec.at(num_iters * .999) / freq_ghz);
       } else {
-        printf("%zu %zu -1.0 -1.0\n", size, ns_avg_realtime);
+        row.add("avg_rdtsc_ns", -1.0).add("p50_ns", -1.0).add("p999_ns", -1.0);
       }
+      row.add("sum", sum);
+      writer.write(row);
     }
-
-    printf("Fences verification:\n%s\n", verify_tsc_str.str().c_str());
-    printf("sum = %zu\n", sum);
   }
 }
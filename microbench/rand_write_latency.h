@@ -1,12 +1,12 @@
 #include "bench.h"
 
-void bench_rand_write_latency(uint8_t *pbuf) {
+void bench_rand_write_latency(uint8_t *pbuf, const std::vector<size_t> &sizes,
+                              ResultWriter &writer) {
   double freq_ghz = measure_rdtsc_freq();
 
   static constexpr size_t kWriteBytes = MB(64);
   static constexpr size_t kMinIters = 50000;
   static constexpr size_t kMinWriteSz = 64;
-  static constexpr size_t kMaxWriteSz = KB(64);
 
   size_t file_offset = 0;
   pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
@@ -15,13 +15,11 @@ void bench_rand_write_latency(uint8_t *pbuf) {
   std::vector<size_t> latency_vec;
   latency_vec.reserve(kWriteBytes / kMinWriteSz);
 
-  uint8_t *data = reinterpret_cast<uint8_t *>(memalign(4096, kMaxWriteSz));
+  const size_t max_write_sz = *std::max_element(sizes.begin(), sizes.end());
+  uint8_t *data = reinterpret_cast<uint8_t *>(memalign(4096, max_write_sz));
 
   for (size_t msr = 0; msr < 10; msr++) {
-    printf("size avg_ns 50_ns 999_ns\n");
-    std::ostringstream verify_tsc_str;  // Compare tsc results with realtime
-
-    for (size_t size = kMinWriteSz; size <= kMaxWriteSz; size *= 2) {
+    for (size_t size : sizes) {
       struct timespec start_time;
       clock_gettime(CLOCK_REALTIME, &start_time);
 
@@ -34,25 +32,25 @@ void bench_rand_write_latency(uint8_t *pbuf) {
 
         size_t start_tsc = timer::Start();
         pmem_memmove_persist(&pbuf[file_offset], data, size);
+        emul_persist_delay(size);
 
         latency_vec.push_back(timer::Stop() - start_tsc);
       }
 
-      size_t ns_avg_realtime = ns_since(start_time) / num_iters;
-      size_t ns_avg_rdtsc =
-          std::accumulate(latency_vec.begin(), latency_vec.end(), 0.0) /
-          (latency_vec.size() * freq_ghz);
-      verify_tsc_str << size << ": Average latency (ns) " << ns_avg_realtime
-                     << " (realtime) " << ns_avg_rdtsc << " (rdtsc) "
-                     << (ns_avg_realtime - ns_avg_rdtsc) << " (delta) "
-                     << "\n";
+      // The rdtsc average verifies the timer's fences against realtime
+      ResultRow row;
+      row.add("benchmark", "rand_write_latency").add("msr", msr);
+      row.add("size", size).add("avg_ns", ns_since(start_time) / num_iters);
+      row.add("avg_rdtsc_ns",
+              std::accumulate(latency_vec.begin(), latency_vec.end(), 0.0) /
+                  (latency_vec.size() * freq_ghz));
 
       std::sort(latency_vec.begin(), latency_vec.end());
-      printf("%zu %zu %.1f %.1f\n", size, ns_avg_realtime,
-             latency_vec.at(num_iters * .50) / freq_ghz,
-             latency_vec.at(num_iters * .999) / freq_ghz);
+      row.add("p50_ns", latency_vec.at(num_iters * .50) / freq_ghz);
+      row.add("p999_ns", latency_vec.at(num_iters * .999) / freq_ghz);
+      writer.write(row);
     }
-
-    printf("Fences verification:\n%s\n", verify_tsc_str.str().c_str());
   }
+
+  free(data);
 }
@@ -1,7 +1,7 @@
 #include "bench.h"
 
 void bench_rand_write_tput(uint8_t *pbuf, size_t thread_id, size_t copy_sz,
-                           size_t num_threads) {
+                           size_t num_threads, double *tput_GBps) {
   static constexpr size_t kBatchSize = 8;
   static constexpr size_t kNumIters = GB(64);
 
@@ -30,13 +30,12 @@ void bench_rand_write_tput(uint8_t *pbuf, size_t thread_id, size_t copy_sz,
         pmem_memcpy_nodrain(&pbuf[offset[j]], copy_arr, copy_sz);
       }
       pmem_drain();
+      emul_persist_delay(kBatchSize * copy_sz);
     }
 
     double tot_sec = sec_since(start);
-    double rate = kNumIters / tot_sec;
-    double tput_GBps = kNumIters * copy_sz / (1000000000 * tot_sec);
-
-    printf("Thread %zu of %zu, size %zu: rand writes: (%.2f M/s, %.2f GB/s)\n",
-           thread_id, num_threads, copy_sz, rate / 1000000, tput_GBps);
+    *tput_GBps = kNumIters * copy_sz / (1000000000 * tot_sec);
   }
+
+  delete[] copy_arr;
 }
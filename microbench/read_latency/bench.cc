@@ -1,76 +1,192 @@
-#include <assert.h>
-#include <libpmem.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <sys/types.h>
-#include <time.h>
-#include <unistd.h>
-#include <pcg/pcg_random.hpp>
-#include <random>
-
-static constexpr size_t kNumIters = 1000000;
-static constexpr size_t kFileSizeGB = 512;
-static constexpr size_t kFileSizeBytes = (1ull << 30) * kFileSizeGB;
-// static constexpr const char *kPmemFile = "/mnt/pmem12/raft_log";
-static constexpr const char *kPmemFile = "/dev/dax0.0";
-
-inline uint32_t fastrand(uint64_t &seed) {
-  seed = seed * 1103515245 + 12345;
-  return static_cast<uint32_t>(seed >> 32);
-}
+/**
+ * @file bench.cc
+ * @brief Dependent read latency with a pointer chase over a random
+ * permutation of a working set, to separate the CPU caches, the DIMMs'
+ * internal buffers, and the media
+ *
+ * Each node of the working set is stride bytes and starts with a pointer to
+ * the next node. The chain visits every node once in a pseudorandom order, so
+ * each load's address depends on the previous load and hardware prefetchers
+ * can't help. With a non-zero page_size, the chain visits all nodes in a page
+ * before moving to another random page, which keeps TLB misses out of the
+ * measurement.
+ */
+#include "../bench.h"
 
-/// Return nanoseconds elapsed since timestamp \p t0
-static double ns_since(const struct timespec &t0) {
-  struct timespec t1;
-  clock_gettime(CLOCK_REALTIME, &t1);
-  return (t1.tv_sec - t0.tv_sec) * 1000000000.0 + (t1.tv_nsec - t0.tv_nsec);
-}
+DEFINE_string(pmem_file, kPmemFile,
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram");
+DEFINE_string(working_sets, "8M,32M,128M,512M,2G,8G,32G",
+              "Comma-separated working set sizes, with K, M or G suffixes");
+DEFINE_uint64(stride, 64, "Bytes per node of the chain, a multiple of 64");
+DEFINE_uint64(page_size, 0,
+              "Chase within pages of this many bytes before moving to another "
+              "page. Zero chases randomly over the whole working set.");
+DEFINE_uint64(build_threads, 0,
+              "Threads that build the chain. Zero means all cores of the NUMA "
+              "node.");
+DEFINE_uint64(num_loads, 10000000, "Dependent loads per measurement");
+DEFINE_uint64(num_msr, 3, "Measurements per working set");
+DEFINE_string(format, "csv", "Result format: csv or json");
+DEFINE_string(output_file, "",
+              "Append results to this file. Empty means stdout.");
+
+/// A pseudorandom permutation of [0, n). It is a Feistel network over the
+/// smallest power of four that's at least n, with cycle-walking to skip values
+/// outside [0, n). Computing one element doesn't need the others, so threads
+/// can build different parts of the chain independently.
+class FeistelPermutation {
+ public:
+  FeistelPermutation(size_t n, uint64_t seed) : n(n), seed(seed) {
+    while ((1ull << (2 * half_bits)) < n) half_bits++;
+    half_mask = (1ull << half_bits) - 1;
+  }
+
+  size_t operator()(size_t x) const {
+    do {
+      x = encrypt(x);
+    } while (x >= n);
+    return x;
+  }
+
+ private:
+  static constexpr size_t kNumRounds = 4;
 
-// Used for shuffle-based pointer chain measurement
-struct cacheline_t {
-  cacheline_t *ptr;
-  size_t pad[7];
+  /// The splitmix64 finalizer
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  size_t encrypt(size_t x) const {
+    uint64_t left = x >> half_bits, right = x & half_mask;
+    for (size_t round = 0; round < kNumRounds; round++) {
+      const uint64_t new_right = left ^ (mix(right ^ seed ^ round) & half_mask);
+      left = right;
+      right = new_right;
+    }
+    return (left << half_bits) | right;
+  }
+
+  const size_t n;
+  const uint64_t seed;
+  size_t half_bits = 1;
+  size_t half_mask;
 };
-static_assert(sizeof(cacheline_t) == 64, "");
 
-int main() {
-  if (getuid() != 0) {
-    // Mapping devdax files needs root perms for now
-    printf("You need to be root to run this benchmark\n");
-    exit(-1);
+/// The node at position \p pos of the chain
+class ChainOrder {
+ public:
+  ChainOrder(size_t num_nodes, size_t nodes_per_page, uint64_t seed)
+      : nodes_per_page(nodes_per_page),
+        page_perm(num_nodes / nodes_per_page, seed),
+        seed(seed) {}
+
+  size_t node_at(size_t pos) const {
+    const size_t page_pos = pos / nodes_per_page;
+    // Each page gets its own order
+    FeistelPermutation node_perm(nodes_per_page, seed + page_pos + 1);
+    return page_perm(page_pos) * nodes_per_page +
+           node_perm(pos % nodes_per_page);
   }
 
-  printf("Measuring random read latency with buffer size = %zu GB\n",
-         kFileSizeGB);
+ private:
+  const size_t nodes_per_page;
+  const FeistelPermutation page_perm;
+  const uint64_t seed;
+};
 
-  size_t mapped_len;
-  int is_pmem;
-  uint8_t *pbuf = reinterpret_cast<uint8_t *>(
-      pmem_map_file(kPmemFile, 0, 0, 0666, &mapped_len, &is_pmem));
-  assert(pbuf != nullptr);
-  assert(mapped_len >= kFileSizeBytes);
-  assert(is_pmem == 1);
+/// Link chain positions [pos_begin, pos_end) to their successors
+void build_chain(uint8_t *pbuf, const ChainOrder *order, size_t num_nodes,
+                 size_t pos_begin, size_t pos_end) {
+  size_t node = order->node_at(pos_begin);
+  for (size_t pos = pos_begin; pos < pos_end; pos++) {
+    const size_t next_node = order->node_at((pos + 1) % num_nodes);
+    uint8_t *next_addr = &pbuf[next_node * FLAGS_stride];
+    memcpy(&pbuf[node * FLAGS_stride], &next_addr, sizeof(next_addr));
+    node = next_node;
+  }
+}
 
-  size_t sum = 0;
-  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+/// Follow the chain for \p num_loads loads, starting at \p ptr
+static inline void *chase(void *ptr, size_t num_loads) {
+  for (size_t i = 0; i < num_loads; i++) ptr = *static_cast<void **>(ptr);
+  return ptr;
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  rt_assert(FLAGS_stride >= 64 && FLAGS_stride % 64 == 0, "Invalid stride");
+  rt_assert(FLAGS_page_size % FLAGS_stride == 0,
+            "Page size must be a multiple of the stride");
+
+  const std::vector<size_t> working_sets = parse_size_list(FLAGS_working_sets);
+  rt_assert(!working_sets.empty(), "No working sets");
+  const size_t max_working_set =
+      *std::max_element(working_sets.begin(), working_sets.end());
+  const size_t build_threads = FLAGS_build_threads > 0
+                                   ? FLAGS_build_threads
+                                   : num_lcores_per_numa_node();
+
+  ResultWriter writer(FLAGS_format, FLAGS_output_file);
+  freq_ghz = measure_rdtsc_freq();
 
-  for (size_t msr = 0; msr < 10; msr++) {
-    // Initialize measurement
-    struct timespec bench_start;
-    clock_gettime(CLOCK_REALTIME, &bench_start);
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, max_working_set);
+  uint8_t *pbuf = region.buf;
 
-    // Real work
-    for (size_t i = 0; i < kNumIters; i++) {
-      size_t file_offset = (sum + pcg()) % kFileSizeBytes;
-      sum += pbuf[file_offset];  // Make the next read dependent
+  ResultRow metadata;
+  metadata.add("pmem_file", FLAGS_pmem_file);
+  metadata.add("pmem_mode", pmem_backend_str(region.backend));
+  metadata.add("stride", static_cast<size_t>(FLAGS_stride));
+  metadata.add("page_size", static_cast<size_t>(FLAGS_page_size));
+  metadata.add("rdtsc_freq_ghz", freq_ghz);
+  writer.write_metadata(metadata);
+
+  size_t sum = 0;
+  for (size_t working_set : working_sets) {
+    const size_t page_size =
+        FLAGS_page_size > 0 ? FLAGS_page_size : working_set;
+    const size_t num_pages = working_set / page_size;
+    rt_assert(num_pages > 0, "Working set smaller than a page");
+    const size_t num_nodes = num_pages * (page_size / FLAGS_stride);
+
+    struct timespec build_start;
+    clock_gettime(CLOCK_REALTIME, &build_start);
+    const ChainOrder order(num_nodes, page_size / FLAGS_stride, sum);
+    std::vector<std::thread> threads(build_threads);
+    for (size_t i = 0; i < build_threads; i++) {
+      threads[i] = std::thread(build_chain, pbuf, &order, num_nodes,
+                               num_nodes * i / build_threads,
+                               num_nodes * (i + 1) / build_threads);
+      bind_to_core(threads[i], kNumaNode, i % num_lcores_per_numa_node());
     }
+    for (auto &t : threads) t.join();
+    fprintf(stderr, "Built chain of %zu nodes in %.2f s\n", num_nodes,
+            ns_since(build_start) / 1000000000.0);
 
-    double bench_ns = ns_since(bench_start);
-    printf("Average read latency = %.1f ns, sum = %zu\n", bench_ns / kNumIters,
-           sum);
+    // Warm up, e.g., to fill the caches for working sets that fit in them
+    void *ptr = chase(&pbuf[order.node_at(0) * FLAGS_stride],
+                      std::min(num_nodes, FLAGS_num_loads));
+
+    for (size_t msr = 0; msr < FLAGS_num_msr; msr++) {
+      struct timespec start;
+      clock_gettime(CLOCK_REALTIME, &start);
+      const size_t start_tsc = rdtsc();
+      ptr = chase(ptr, FLAGS_num_loads);
+      const double cycles =
+          static_cast<double>(rdtsc() - start_tsc) / FLAGS_num_loads;
+      const double avg_ns = ns_since(start) / FLAGS_num_loads;
+      sum += reinterpret_cast<size_t>(ptr);
+
+      ResultRow row;
+      row.add("benchmark", "pointer_chase").add("msr", msr);
+      row.add("working_set", working_set).add("avg_ns", avg_ns);
+      row.add("avg_cycles", cycles);
+      writer.write(row);
+    }
   }
 
-  pmem_unmap(pbuf, mapped_len);
+  fprintf(stderr, "sum = %zu\n", sum);
+  unmap_pmem_region(region);
   exit(0);
 }
@@ -1,6 +1,7 @@
 #include "bench.h"
 
-void bench_seq_write_latency(uint8_t *pbuf) {
+void bench_seq_write_latency(uint8_t *pbuf, const std::vector<size_t> &sizes,
+                             ResultWriter &writer) {
   double freq_ghz = measure_rdtsc_freq();
 
   static constexpr bool kMeasurePercentiles = true;
@@ -11,7 +12,6 @@ void bench_seq_write_latency(uint8_t *pbuf) {
   static constexpr size_t kWriteBytes = MB(64);
   static constexpr size_t kMinIters = 50000;
   static constexpr size_t kMinWriteSz = 64;
-  static constexpr size_t kMaxWriteSz = KB(64);
 
   size_t file_offset = 0;
 
@@ -19,14 +19,12 @@ void bench_seq_write_latency(uint8_t *pbuf) {
   std::vector<size_t> latency_vec;
   latency_vec.reserve(kWriteBytes / kMinWriteSz);
 
-  size_t *data = reinterpret_cast<size_t *>(memalign(4096, kMaxWriteSz));
-  memset(data, 31, kMaxWriteSz);
+  const size_t max_write_sz = *std::max_element(sizes.begin(), sizes.end());
+  size_t *data = reinterpret_cast<size_t *>(memalign(4096, max_write_sz));
+  memset(data, 31, max_write_sz);
 
   for (size_t msr = 0; msr < 100; msr++) {
-    printf("size avg_ns 50_ns 999_ns\n");
-    std::ostringstream verify_tsc_str;  // Compare tsc results with realtime
-
-    for (size_t wr_size = kMinWriteSz; wr_size <= kMaxWriteSz; wr_size *= 2) {
+    for (size_t wr_size : sizes) {
       struct timespec start_time;
       clock_gettime(CLOCK_REALTIME, &start_time);
 
@@ -44,6 +42,7 @@ void bench_seq_write_latency(uint8_t *pbuf) {
         size_t start_tsc;
         if (kMeasurePercentiles) start_tsc = timer::Start();
         pmem_memmove_persist(&pbuf[file_offset], data, wr_size);
+        emul_persist_delay(wr_size);
 
         if (kMeasurePercentiles) {
           latency_vec.push_back(timer::Stop() - start_tsc);
@@ -53,26 +52,24 @@ void bench_seq_write_latency(uint8_t *pbuf) {
         if (file_offset + wr_size >= kPmemFileSize) file_offset = 0;
       }
 
-      size_t ns_avg_realtime = ns_since(start_time) / num_iters;
+      ResultRow row;
+      row.add("benchmark", "seq_write_latency").add("msr", msr);
+      row.add("size", wr_size).add("avg_ns", ns_since(start_time) / num_iters);
 
+      // The rdtsc average verifies the timer's fences against realtime
       if (kMeasurePercentiles) {
         std::sort(latency_vec.begin(), latency_vec.end());
-        printf("%zu %zu %.1f %.1f\n", wr_size, ns_avg_realtime,
-               latency_vec.at(num_iters * .50) / freq_ghz,
-               latency_vec.at(num_iters * .999) / freq_ghz);
-
-        size_t ns_avg_rdtsc =
-            std::accumulate(latency_vec.begin(), latency_vec.end(), 0.0) /
-            (latency_vec.size() * freq_ghz);
-        verify_tsc_str << wr_size << ": Avg latency (ns) " << ns_avg_realtime
-                       << " (realtime) " << ns_avg_rdtsc << " (rdtsc) "
-                       << (ns_avg_realtime - ns_avg_rdtsc) << " (delta). offst "
-                       << file_offset << "\n";
+        row.add("avg_rdtsc_ns",
+                std::accumulate(latency_vec.begin(), latency_vec.end(), 0.0) /
+                    (latency_vec.size() * freq_ghz));
+        row.add("p50_ns", latency_vec.at(num_iters * .50) / freq_ghz);
+        row.add("p999_ns", latency_vec.at(num_iters * .999) / freq_ghz);
       } else {
-        printf("%zu %zu -1.0 -1.0\n", wr_size, ns_avg_realtime);
+        row.add("avg_rdtsc_ns", -1.0).add("p50_ns", -1.0).add("p999_ns", -1.0);
       }
+      writer.write(row);
     }
-
-    printf("Fences verification:\n%s\n", verify_tsc_str.str().c_str());
   }
+
+  free(data);
 }
@@ -1,7 +1,7 @@
 #include "bench.h"
 
-void bench_seq_write_tput(uint8_t *pbuf, size_t thread_id, size_t copy_sz,
-                          double *avg_tput_GBps) {
+void bench_seq_write_tput(uint8_t *pbuf, size_t thread_id, size_t num_threads,
+                          size_t copy_sz, double *avg_tput_GBps) {
   // We perform multiple measurements. In each measurement, a thread writes
   // kCopyPerThreadPerMsr bytes in copy_sz chunks.
   static constexpr size_t kNumMsr = 1;
@@ -12,7 +12,7 @@ void bench_seq_write_tput(uint8_t *pbuf, size_t thread_id, size_t copy_sz,
   memset(dram_src_buf, 0, copy_sz);
 
   // Each thread write to non-overlapping addresses
-  const size_t excl_bytes_per_thread = kPmemFileSize / FLAGS_num_threads;
+  const size_t excl_bytes_per_thread = kPmemFileSize / num_threads;
   const size_t base_offset = roundup<256>(thread_id * excl_bytes_per_thread);
 
   // We begin copies from a random aligned offset in the file. This prevents
@@ -30,6 +30,7 @@ void bench_seq_write_tput(uint8_t *pbuf, size_t thread_id, size_t copy_sz,
 
     for (size_t i = 0; i < kCopyPerThreadPerMsr / copy_sz; i++) {
       pmem_memmove_persist(&pbuf[offset], dram_src_buf, copy_sz);
+      emul_persist_delay(copy_sz);
       offset += copy_sz;
       if (offset + copy_sz >= base_offset + excl_bytes_per_thread) {
         offset = base_offset;
@@ -37,10 +38,7 @@ void bench_seq_write_tput(uint8_t *pbuf, size_t thread_id, size_t copy_sz,
     }
 
     double tot_sec = sec_since(start);
-    double tput_GBps = kCopyPerThreadPerMsr / (tot_sec * 1000000000);
-    printf("Thread %zu: copy_sz %zu, %.2f GB/s. Offset = %zu\n", thread_id,
-           copy_sz, tput_GBps, offset);
-    tput_sum_GBps += tput_GBps;
+    tput_sum_GBps += kCopyPerThreadPerMsr / (tot_sec * 1000000000);
   }
 
   *avg_tput_GBps = tput_sum_GBps / kNumMsr;
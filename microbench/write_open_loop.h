@@ -0,0 +1,45 @@
+#include "bench.h"
+#include "../utils/open_loop.h"
+
+/// Random persistent writes at offered loads of \p rates_mops. Latency is
+/// measured from each write's scheduled start, so it includes queueing.
+void bench_write_open_loop(uint8_t *pbuf, const std::vector<size_t> &sizes,
+                           const std::vector<double> &rates_mops,
+                           ArrivalGenerator::Type arrival_type,
+                           ResultWriter &writer) {
+  static constexpr size_t kMeasureSec = 1;
+  static constexpr size_t kMaxOps = MB(4);  // Bounds the latency vector
+
+  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+  const size_t max_size = *std::max_element(sizes.begin(), sizes.end());
+  auto *data = static_cast<uint8_t *>(memalign(4096, max_size));
+  memset(data, 31, max_size);
+
+  for (size_t size : sizes) {
+    for (double rate_mops : rates_mops) {
+      const size_t num_ops =
+          std::min(kMaxOps, static_cast<size_t>(rate_mops * 1000000) *
+                                kMeasureSec);
+      auto op = [&]() {
+        const size_t file_offset =
+            roundup<64>(get_random_offset_with_space(pcg, size + 64));
+        data[0]++;
+        pmem_memmove_persist(&pbuf[file_offset], data, size);
+        emul_persist_delay(size);
+      };
+
+      const OpenLoopResult result =
+          run_open_loop(op, num_ops, arrival_type, rate_mops, freq_ghz);
+
+      ResultRow row;
+      row.add("benchmark", "write_open_loop").add("size", size);
+      row.add("offered_mops", result.offered_mops);
+      row.add("achieved_mops", result.achieved_mops);
+      row.add("avg_ns", result.avg_ns).add("p50_ns", result.p50_ns);
+      row.add("p99_ns", result.p99_ns).add("p999_ns", result.p999_ns);
+      writer.write(row);
+    }
+  }
+
+  free(data);
+}
@@ -0,0 +1,40 @@
+#include "bench.h"
+#include "../utils/latency_timeline.h"
+
+/**
+ * @brief Persistently write \p copy_sz bytes in this thread's part of the
+ * file for \p duration_sec, recording each write's latency into \p timeline
+ *
+ * @param random Random offsets if true, else sequential
+ */
+void bench_write_timeline(uint8_t *pbuf, size_t thread_id, size_t num_threads,
+                          size_t copy_sz, bool random, size_t duration_sec,
+                          LatencyTimeline *timeline) {
+  static constexpr size_t kOpsPerTimeCheck = 1024;
+
+  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
+  const size_t part_size = kPmemFileSize / num_threads;
+  const size_t num_slots = part_size / copy_sz;
+  uint8_t *part = &pbuf[thread_id * part_size];
+  auto *dram_buf = static_cast<uint8_t *>(memalign(4096, copy_sz));
+  memset(dram_buf, 31, copy_sz);
+
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  size_t slot = 0, end_tsc = 0;
+  while (sec_since(start) < duration_sec) {
+    for (size_t i = 0; i < kOpsPerTimeCheck; i++) {
+      slot = random ? pcg() % num_slots : (slot + 1) % num_slots;
+      dram_buf[0]++;
+
+      const size_t start_tsc = timer::Start();
+      pmem_memcpy_persist(&part[slot * copy_sz], dram_buf, copy_sz);
+      emul_persist_delay(copy_sz);
+      end_tsc = timer::Stop();
+      timeline->record(end_tsc - start_tsc, end_tsc);
+    }
+  }
+
+  timeline->finish(end_tsc);
+  free(dram_buf);
+}
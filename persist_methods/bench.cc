@@ -0,0 +1,262 @@
+/**
+ * @file bench.cc
+ * @brief Latency and bandwidth of each way to persist writes: non-temporal
+ * stores, clwb, clflushopt, clflush, and libpmem's choice. Each is measured
+ * with sfences after every cacheline, after every write, or never, for
+ * sequential, random, and same-address writes.
+ *
+ * Instructions that the CPU doesn't support are skipped.
+ */
+
+#include <gflags/gflags.h>
+#include <immintrin.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <vector>
+#include "../common.h"
+#include "../utils/cpuid.h"
+#include "../utils/numa_topology.h"
+#include "../utils/parse_list.h"
+#include "../utils/pmem_region.h"
+#include "../utils/result_writer.h"
+#include "../utils/timer.h"
+
+DEFINE_string(pmem_file, "/dev/dax0.0",
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram");
+DEFINE_uint64(region_size, GB(4), "Bytes of pmem written to");
+DEFINE_string(sizes, "64,256,1024,4096", "Comma-separated write sizes");
+DEFINE_uint64(num_writes, 200000, "Writes per configuration");
+DEFINE_string(format, "csv", "Result format: csv or json");
+DEFINE_string(output_file, "",
+              "Append results to this file. Empty means stdout.");
+
+enum class PersistMethod { kNtStore, kClwb, kClflushopt, kClflush, kLibpmem };
+enum class FencePlacement { kPerLine, kPerWrite, kNone };
+enum class Pattern { kSeq, kRand, kSame };
+
+static const char *method_str(PersistMethod method) {
+  switch (method) {
+    case PersistMethod::kNtStore:
+      return "ntstore";
+    case PersistMethod::kClwb:
+      return "clwb";
+    case PersistMethod::kClflushopt:
+      return "clflushopt";
+    case PersistMethod::kClflush:
+      return "clflush";
+    case PersistMethod::kLibpmem:
+      return "libpmem";
+  }
+  return "invalid";
+}
+
+static const char *fence_str(FencePlacement fence) {
+  switch (fence) {
+    case FencePlacement::kPerLine:
+      return "per_line";
+    case FencePlacement::kPerWrite:
+      return "per_write";
+    case FencePlacement::kNone:
+      return "none";
+  }
+  return "invalid";
+}
+
+static const char *pattern_str(Pattern pattern) {
+  switch (pattern) {
+    case Pattern::kSeq:
+      return "seq";
+    case Pattern::kRand:
+      return "rand";
+    case Pattern::kSame:
+      return "same";
+  }
+  return "invalid";
+}
+
+/// Write and flush one cacheline. libpmem writes are handled by the caller.
+template <PersistMethod kMethod>
+static inline void write_line(uint8_t *dst, const uint8_t *src) {
+  if (kMethod == PersistMethod::kNtStore) {
+    for (size_t i = 0; i < 64; i += 16) {
+      const __m128i v =
+          _mm_load_si128(reinterpret_cast<const __m128i *>(src + i));
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+    return;
+  }
+
+  memcpy(dst, src, 64);
+  switch (kMethod) {
+    case PersistMethod::kClwb:
+      pmem_clwb(dst);
+      break;
+    case PersistMethod::kClflushopt:
+      pmem_clflushopt(dst);
+      break;
+    case PersistMethod::kClflush:
+      pmem_clflush(dst);
+      break;
+    default:
+      break;
+  }
+}
+
+/// Persist \p size bytes from \p src to \p dst, fencing as \p kFence says
+template <PersistMethod kMethod, FencePlacement kFence>
+static inline void persist_write(uint8_t *dst, const uint8_t *src,
+                                 size_t size) {
+  if (kMethod == PersistMethod::kLibpmem) {
+    if (kFence == FencePlacement::kPerLine) {
+      for (size_t i = 0; i < size; i += 64) {
+        pmem_memcpy_persist(dst + i, src + i, 64);
+        emul_persist_delay(64);
+      }
+    } else if (kFence == FencePlacement::kPerWrite) {
+      pmem_memcpy_persist(dst, src, size);
+      emul_persist_delay(size);
+    } else {
+      pmem_memcpy_nodrain(dst, src, size);
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < size; i += 64) {
+    write_line<kMethod>(dst + i, src + i);
+    if (kFence == FencePlacement::kPerLine) {
+      sfence();
+      emul_persist_delay(64);
+    }
+  }
+  if (kFence == FencePlacement::kPerWrite) {
+    sfence();
+    emul_persist_delay(size);
+  }
+}
+
+/// Measure one configuration and write its result row
+template <PersistMethod kMethod, FencePlacement kFence>
+void bench_one(uint8_t *pbuf, Pattern pattern, size_t size, double freq_ghz,
+               ResultWriter &writer) {
+  auto *src = static_cast<uint8_t *>(aligned_alloc(64, size));
+  memset(src, 31, size);
+  FastRand fast_rand;
+  std::vector<size_t> latency_vec;
+  latency_vec.reserve(FLAGS_num_writes);
+
+  const size_t num_slots = FLAGS_region_size / size;
+  size_t offset = 0;
+
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  for (size_t i = 0; i < FLAGS_num_writes; i++) {
+    switch (pattern) {
+      case Pattern::kSeq:
+        offset = (i % num_slots) * size;
+        break;
+      case Pattern::kRand:
+        offset = (fast_rand.next_u32() % num_slots) * size;
+        break;
+      case Pattern::kSame:
+        break;
+    }
+    src[0]++;
+
+    const size_t start_tsc = timer::Start();
+    persist_write<kMethod, kFence>(&pbuf[offset], src, size);
+    latency_vec.push_back(timer::Stop() - start_tsc);
+  }
+  sfence();  // Unfenced writes count as persisted after this
+  if (kFence == FencePlacement::kNone) {
+    emul_persist_delay(FLAGS_num_writes * size);
+  }
+  const double total_ns = ns_since(start);
+
+  std::sort(latency_vec.begin(), latency_vec.end());
+  ResultRow row;
+  row.add("method", method_str(kMethod)).add("fence", fence_str(kFence));
+  row.add("pattern", pattern_str(pattern)).add("size", size);
+  row.add("avg_ns",
+          std::accumulate(latency_vec.begin(), latency_vec.end(), 0.0) /
+              (latency_vec.size() * freq_ghz));
+  row.add("p50_ns", latency_vec.at(latency_vec.size() / 2) / freq_ghz);
+  row.add("p99_ns", latency_vec.at(latency_vec.size() * 99 / 100) / freq_ghz);
+  row.add("GBps", FLAGS_num_writes * size / total_ns);
+  writer.write(row);
+
+  free(src);
+}
+
+/// Measure one method with each fence placement
+template <PersistMethod kMethod>
+void bench_method(uint8_t *pbuf, Pattern pattern, size_t size, double freq_ghz,
+                  ResultWriter &writer) {
+  bench_one<kMethod, FencePlacement::kPerLine>(pbuf, pattern, size, freq_ghz,
+                                               writer);
+  bench_one<kMethod, FencePlacement::kPerWrite>(pbuf, pattern, size, freq_ghz,
+                                                writer);
+  bench_one<kMethod, FencePlacement::kNone>(pbuf, pattern, size, freq_ghz,
+                                            writer);
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  const std::vector<size_t> sizes = parse_size_list(FLAGS_sizes);
+  for (size_t size : sizes) {
+    rt_assert(size >= 64 && size % 64 == 0, "Sizes must be multiples of 64");
+    rt_assert(size <= FLAGS_region_size, "Size larger than the region");
+  }
+
+  const CpuFeatures features = get_cpu_features();
+  const double freq_ghz = measure_rdtsc_freq();
+  ResultWriter writer(FLAGS_format, FLAGS_output_file);
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, FLAGS_region_size);
+  pmem_memset_persist(region.buf, 0, FLAGS_region_size);  // Fault in pages
+
+  // Run on the cores nearest to the region
+  const size_t numa_node = get_region_cpu_node(FLAGS_pmem_file, region.buf);
+  rt_assert(numa_run_on_node(static_cast<int>(numa_node)) == 0,
+            "Failed to bind to the region's NUMA node");
+
+  ResultRow metadata;
+  metadata.add("pmem_file", FLAGS_pmem_file);
+  metadata.add("pmem_mode", pmem_backend_str(region.backend));
+  metadata.add("numa_node", numa_node);
+  metadata.add("clflushopt", features.clflushopt ? "yes" : "no");
+  metadata.add("clwb", features.clwb ? "yes" : "no");
+  metadata.add("rdtsc_freq_ghz", freq_ghz);
+  writer.write_metadata(metadata);
+
+  for (Pattern pattern : {Pattern::kSeq, Pattern::kRand, Pattern::kSame}) {
+    for (size_t size : sizes) {
+      uint8_t *pbuf = region.buf;
+      bench_method<PersistMethod::kNtStore>(pbuf, pattern, size, freq_ghz,
+                                            writer);
+      if (features.clwb) {
+        bench_method<PersistMethod::kClwb>(pbuf, pattern, size, freq_ghz,
+                                           writer);
+      }
+      if (features.clflushopt) {
+        bench_method<PersistMethod::kClflushopt>(pbuf, pattern, size,
+                                                 freq_ghz, writer);
+      }
+      if (features.clflush) {
+        bench_method<PersistMethod::kClflush>(pbuf, pattern, size, freq_ghz,
+                                              writer);
+      }
+      bench_method<PersistMethod::kLibpmem>(pbuf, pattern, size, freq_ghz,
+                                            writer);
+    }
+  }
+
+  unmap_pmem_region(region);
+  exit(0);
+}
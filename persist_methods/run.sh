@@ -0,0 +1,4 @@
+exe="./bench"
+chmod +x $exe
+
+numactl --membind=0 $exe "$@"
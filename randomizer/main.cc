@@ -1,52 +1,154 @@
-// This can be used to write random contents to a pmem file so that later
-// experiments don't benefit from any crazy value prediction of a zeroed file.
+// This preconditions a pmem file so that later experiments don't benefit from
+// any crazy value prediction of a zeroed file.
+//
+// All cores on the pmem's NUMA node fill disjoint parts of the file. If that
+// node has no CPUs, the nearest node with CPUs is used instead. Each
+// thread generates its data on the fly into a small NUMA-local buffer, so no
+// large random template is needed. Modes:
+//  - random: pseudorandom bytes
+//  - zero: zeroes
+//  - pattern: self-checking 4 KB blocks from utils/fill_pattern.h, which
+//    --verify or later benchmarks can check with verify_pattern_block()
 
+#include <gflags/gflags.h>
 #include <libpmem.h>
-#include <pcg/pcg_random.hpp>
+#include <unistd.h>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
 #include "../common.h"
+#include "../utils/fill_pattern.h"
+#include "../utils/numa_topology.h"
+#include "../utils/pmem_region.h"
 
-static constexpr const char *kPmemFile = "/mnt/pmem12/raft_log";
-static constexpr size_t kPmemFileSizeGB = 512;  // The expected file size
-static constexpr size_t kPmemFileSize = kPmemFileSizeGB * GB(1);
-static constexpr size_t kRandTemplateSz = GB(32);
-
-int main(int, char **) {
-  uint8_t *pbuf;
-  size_t mapped_len;
-  int is_pmem;
-
-  pbuf = reinterpret_cast<uint8_t *>(pmem_map_file(
-      kPmemFile, 0 /* length */, 0 /* flags */, 0666, &mapped_len, &is_pmem));
-
-  rt_assert(pbuf != nullptr,
-            "pmem_map_file() failed. " + std::string(strerror(errno)));
-  rt_assert(mapped_len >= kPmemFileSize,
-            "pmem file too small " + std::to_string(mapped_len));
-  rt_assert(reinterpret_cast<size_t>(pbuf) % 4096 == 0,
-            "Mapped buffer isn't page-aligned");
-  rt_assert(is_pmem == 1, "File is not pmem");
-
-  printf("Generating random contents\n");
-  pcg64_fast pcg(pcg_extras::seed_seq_from<std::random_device>{});
-  size_t *rand_buf = reinterpret_cast<size_t *>(malloc(kRandTemplateSz));
-  for (size_t i = 0; i < kRandTemplateSz / sizeof(size_t); i++) {
-    rand_buf[i] = pcg();
+DEFINE_string(pmem_file, "/mnt/pmem12/raft_log",
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram");
+DEFINE_uint64(size, GB(512),
+              "Bytes to fill. Zero fills a whole fsdax or emulated file.");
+DEFINE_string(mode, "random", "Contents: random, zero, or pattern");
+DEFINE_bool(verify, false,
+            "Check the pattern mode's blocks instead of filling");
+DEFINE_uint64(threads, 0, "Threads. Zero means all cores on the pmem's node.");
+DEFINE_uint64(seed, 0, "Seed for random and pattern data. Zero is random.");
+
+static constexpr size_t kChunkSize = MB(2);  // Per-thread DRAM buffer
+static_assert(kChunkSize % kPatternBlockSize == 0, "");
+
+/// Fill or verify [part, part + part_size), which starts at \p part_offset in
+/// the file, from logical core \p lcore. Progress is added to \p bytes_done,
+/// and bad blocks to \p bad_blocks.
+void thread_func(size_t lcore, uint8_t *part, size_t part_offset,
+                 size_t part_size, uint64_t seed,
+                 std::atomic<size_t> *bytes_done,
+                 std::atomic<size_t> *bad_blocks) {
+  // Bind before allocating, so that the buffer is first touched on our node
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(lcore, &cpuset);
+  int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+  rt_assert(rc == 0, "Error setting thread affinity");
+  std::vector<uint8_t> buf(kChunkSize);
+  PcgLanes lanes(seed);
+
+  for (size_t offset = 0; offset < part_size; offset += kChunkSize) {
+    const size_t len = std::min(kChunkSize, part_size - offset);
+    uint8_t *dst = &part[offset];
+
+    if (FLAGS_verify) {
+      for (size_t b = 0; b < len; b += kPatternBlockSize) {
+        const size_t block_index =
+            (part_offset + offset + b) / kPatternBlockSize;
+        if (!verify_pattern_block(&dst[b], block_index)) (*bad_blocks)++;
+      }
+    } else if (FLAGS_mode == "zero") {
+      pmem_memset_persist(dst, 0, len);
+    } else {
+      if (FLAGS_mode == "random") {
+        lanes.fill(buf.data(), len);
+      } else {
+        for (size_t b = 0; b < len; b += kPatternBlockSize) {
+          const size_t block_index =
+              (part_offset + offset + b) / kPatternBlockSize;
+          fill_pattern_block(&buf[b], block_index, seed);
+        }
+      }
+      pmem_memcpy_persist(dst, buf.data(), len);
+    }
+
+    *bytes_done += len;
   }
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  rt_assert(FLAGS_mode == "random" || FLAGS_mode == "zero" ||
+                FLAGS_mode == "pattern",
+            "Invalid --mode");
+  rt_assert(!FLAGS_verify || FLAGS_mode == "pattern",
+            "--verify needs --mode=pattern");
+
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, FLAGS_size);
+  const size_t fill_size =
+      (FLAGS_size > 0 ? FLAGS_size : region.len) / kPatternBlockSize *
+      kPatternBlockSize;
 
-  printf("Writing random contents to the whole file.\n");
-  rt_assert(kPmemFileSize % kRandTemplateSz == 0);
+  const size_t node = get_nearest_cpu_node(get_pmem_numa_node(FLAGS_pmem_file));
+  const size_t num_lcores = get_lcores_for_numa_node(node).size();
+  const size_t num_threads = FLAGS_threads > 0 ? FLAGS_threads : num_lcores;
+  rt_assert(num_threads > 0, "No cores to run on");
 
-  for (size_t i = 0; i < kPmemFileSize; i += kRandTemplateSz) {
-    struct timespec start;
-    clock_gettime(CLOCK_REALTIME, &start);
-    pmem_memcpy_persist(&pbuf[i], rand_buf, kRandTemplateSz);
-    printf("Fraction complete = %.2f. Took %.3f sec for %zu GB.\n",
-           (i + 1) * 1.0 / kPmemFileSize, sec_since(start),
-           kRandTemplateSz / GB(1));
+  uint64_t seed = FLAGS_seed;
+  if (seed == 0) {
+    std::random_device rand_dev;
+    seed = (static_cast<uint64_t>(rand_dev()) << 32) | rand_dev();
   }
 
-  printf("Done writing.\n");
+  printf("%s %.1f GB of %s (%s) with %zu threads on NUMA node %zu, mode %s\n",
+         FLAGS_verify ? "Verifying" : "Filling", fill_size * 1.0 / GB(1),
+         FLAGS_pmem_file.c_str(), pmem_backend_str(region.backend),
+         num_threads, node, FLAGS_mode.c_str());
+
+  // Parts are whole pattern blocks, so block indices are file-global
+  const size_t num_blocks = fill_size / kPatternBlockSize;
+  std::atomic<size_t> bytes_done(0), bad_blocks(0);
+  const std::vector<size_t> lcores = get_lcores_for_numa_node(node);
+  std::vector<std::thread> threads(num_threads);
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  for (size_t i = 0; i < num_threads; i++) {
+    const size_t first_block = num_blocks * i / num_threads;
+    const size_t end_block = num_blocks * (i + 1) / num_threads;
+    const size_t part_offset = first_block * kPatternBlockSize;
+    threads[i] = std::thread(thread_func, lcores[i % num_lcores],
+                             region.buf + part_offset, part_offset,
+                             (end_block - first_block) * kPatternBlockSize,
+                             seed + i, &bytes_done, &bad_blocks);
+  }
+
+  // Poll often so that the final time is accurate, but print once a second
+  size_t prev_bytes = 0;
+  struct timespec prev_print = start;
+  while (bytes_done < fill_size) {
+    usleep(10000);
+    if (sec_since(prev_print) < 1.0) continue;
+
+    const size_t cur_bytes = bytes_done;
+    printf("Fraction complete = %.2f. %.2f GB/s over the last second.\n",
+           cur_bytes * 1.0 / fill_size,
+           (cur_bytes - prev_bytes) / (sec_since(prev_print) * GB(1)));
+    prev_bytes = cur_bytes;
+    clock_gettime(CLOCK_REALTIME, &prev_print);
+  }
+  const double seconds = sec_since(start);
+  for (auto &t : threads) t.join();
+
+  printf("Done. %.1f GB in %.1f seconds, %.2f GB/s.\n",
+         fill_size * 1.0 / GB(1), seconds, fill_size / (seconds * GB(1)));
+  if (FLAGS_verify) {
+    printf("%zu of %zu blocks are bad.\n", bad_blocks.load(), num_blocks);
+  }
 
-  pmem_unmap(pbuf, mapped_len);
-  exit(0);
+  unmap_pmem_region(region);
+  exit(bad_blocks > 0 ? 1 : 0);
 }
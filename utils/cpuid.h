@@ -0,0 +1,41 @@
+/**
+ * @file cpuid.h
+ * @brief Detect the CPU's cache flush and SIMD instructions with CPUID, so
+ * that benchmarks can skip the ones that would fault
+ */
+#pragma once
+
+#include <cpuid.h>
+#include <stdint.h>
+
+struct CpuFeatures {
+  bool clflush = false;
+  bool clflushopt = false;
+  bool clwb = false;
+  bool avx2 = false;     // Including OS support for the YMM state
+  bool avx512f = false;  // Including OS support for the ZMM and mask state
+};
+
+/// Return the extended control register \p index
+static inline uint64_t cpuid_xgetbv(uint32_t index) {
+  uint32_t eax, edx;
+  asm volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+static CpuFeatures get_cpu_features() {
+  CpuFeatures features;
+  uint32_t eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return features;
+  features.clflush = (edx >> 19) & 1;
+  const bool osxsave = (ecx >> 27) & 1;
+  const uint64_t xcr0 = osxsave ? cpuid_xgetbv(0) : 0;
+
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return features;
+  features.clflushopt = (ebx >> 23) & 1;
+  features.clwb = (ebx >> 24) & 1;
+  features.avx2 = ((ebx >> 5) & 1) && (xcr0 & 0x6) == 0x6;
+  features.avx512f = ((ebx >> 16) & 1) && (xcr0 & 0xe6) == 0xe6;
+  return features;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file crc32c.h
+ * @brief CRC32C (Castagnoli) using the SSE4.2 crc32 instruction
+ */
+#pragma once
+
+#include <nmmintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Update the CRC32C \p crc with \p len bytes at \p buf
+ *
+ * This is the raw update without the initial and final inversions, so
+ * checksums can be chained across buffers: crc32c(crc32c(c, a), b) is the
+ * checksum of a followed by b.
+ */
+static inline uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
+  uint64_t crc64 = crc;
+
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));  // Compiles to a plain unaligned load
+    crc64 = _mm_crc32_u64(crc64, word);
+    p += 8;
+    len -= 8;
+  }
+
+  uint32_t crc32 = static_cast<uint32_t>(crc64);
+  while (len > 0) {
+    crc32 = _mm_crc32_u8(crc32, *p);
+    p++;
+    len--;
+  }
+
+  return crc32;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file fill_pattern.h
+ * @brief Data generators for preconditioning pmem files: fast random data, and
+ * a self-checking block pattern that later benchmarks can verify
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "crc32c.h"
+
+/**
+ * @brief Eight interleaved PCG32 streams. The lanes are independent, so the
+ * compiler vectorizes fill() with -march=native.
+ */
+class PcgLanes {
+ public:
+  static constexpr size_t kLanes = 8;
+
+  explicit PcgLanes(uint64_t seed) {
+    for (size_t i = 0; i < kLanes; i++) {
+      state[i] = seed + i * 0x9e3779b97f4a7c15ull;
+      inc[i] = (i << 1) | 1;  // Distinct odd increments give distinct streams
+    }
+  }
+
+  /// Fill \p buf with \p len bytes. \p len must be a multiple of four.
+  void fill(void *buf, size_t len) {
+    auto *out = static_cast<uint32_t *>(buf);
+    const size_t num_words = len / sizeof(uint32_t);
+    size_t i = 0;
+    for (; i + kLanes <= num_words; i += kLanes) next(&out[i]);
+
+    if (i < num_words) {
+      uint32_t tail[kLanes];
+      next(tail);
+      memcpy(&out[i], tail, (num_words - i) * sizeof(uint32_t));
+    }
+  }
+
+ private:
+  /// Write one output from each lane to \p out
+  inline void next(uint32_t *out) {
+    for (size_t j = 0; j < kLanes; j++) {
+      const uint64_t old = state[j];
+      state[j] = old * 6364136223846793005ull + inc[j];
+      const auto xorshifted =
+          static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+      const auto rot = static_cast<uint32_t>(old >> 59u);
+      out[j] = (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+  }
+
+  uint64_t state[kLanes];
+  uint64_t inc[kLanes];
+};
+
+/**
+ * Pattern blocks are 4 KB. Each has pseudorandom bytes derived from a seed and
+ * the block's index, then the index, then a CRC32C over everything before it.
+ * Verification needs only the index, not the seed.
+ */
+static constexpr size_t kPatternBlockSize = 4096;
+
+struct PatternBlockFooter {
+  uint64_t block_index;
+  uint32_t reserved;
+  uint32_t crc;  // CRC32C of the block up to this field
+};
+
+static constexpr size_t kPatternPayloadSize =
+    kPatternBlockSize - sizeof(PatternBlockFooter);
+static constexpr size_t kPatternCrcOffset =
+    kPatternPayloadSize + offsetof(PatternBlockFooter, crc);
+
+/// Write the pattern for \p block_index to the DRAM buffer \p block
+static void fill_pattern_block(uint8_t *block, size_t block_index,
+                               uint64_t seed) {
+  PcgLanes lanes(seed ^ (block_index * 0xff51afd7ed558ccdull));
+  lanes.fill(block, kPatternPayloadSize);
+
+  auto *footer =
+      reinterpret_cast<PatternBlockFooter *>(block + kPatternPayloadSize);
+  footer->block_index = block_index;
+  footer->reserved = 0;
+  footer->crc = crc32c(0, block, kPatternCrcOffset);
+}
+
+/// Return true iff \p block holds an intact pattern block for \p block_index
+static bool verify_pattern_block(const uint8_t *block, size_t block_index) {
+  PatternBlockFooter footer;
+  memcpy(&footer, block + kPatternPayloadSize, sizeof(footer));
+  return footer.block_index == block_index &&
+         footer.crc == crc32c(0, block, kPatternCrcOffset);
+}
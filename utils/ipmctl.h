@@ -0,0 +1,57 @@
+/**
+ * @file ipmctl.h
+ * @brief Read Optane DIMM performance counters with ipmctl, to compute the
+ * media write amplification of a benchmark phase
+ *
+ * ipmctl usually needs root, and takes a while to run. If it's not available,
+ * the counters read as zero and the ratio is reported as -1.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/// Sums of the counters over all DIMMs. The units are 64-byte accesses.
+struct DimmCounters {
+  size_t media_writes = 0;    // Writes to the 3D-XPoint media
+  size_t write_requests = 0;  // Write requests from the memory controller
+  bool valid = false;
+};
+
+static DimmCounters read_dimm_counters() {
+  DimmCounters counters;
+  FILE *pipe = popen(
+      "ipmctl show -dimm -performance TotalMediaWrites,TotalWriteRequests "
+      "2>/dev/null",
+      "r");
+  if (pipe == nullptr) return counters;
+
+  char line[256];
+  while (fgets(line, sizeof(line), pipe) != nullptr) {
+    const char *eq = strchr(line, '=');
+    if (eq == nullptr) continue;
+    const size_t value = strtoull(eq + 1, nullptr, 0);  // The values are hex
+
+    if (strstr(line, "TotalMediaWrites") != nullptr) {
+      counters.media_writes += value;
+      counters.valid = true;
+    } else if (strstr(line, "TotalWriteRequests") != nullptr) {
+      counters.write_requests += value;
+    }
+  }
+
+  pclose(pipe);
+  return counters;
+}
+
+/// Return media writes per write request between two readings, or -1 if the
+/// counters are unavailable
+static double media_write_ratio(const DimmCounters &before,
+                                const DimmCounters &after) {
+  if (!before.valid || !after.valid) return -1.0;
+  const size_t requests = after.write_requests - before.write_requests;
+  if (requests == 0) return -1.0;
+  return (after.media_writes - before.media_writes) * 1.0 / requests;
+}
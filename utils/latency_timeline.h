@@ -0,0 +1,145 @@
+/**
+ * @file latency_timeline.h
+ * @brief Record op latencies into one histogram per fixed time interval, so
+ * that long runs show when latency stalls (e.g., from wear leveling or
+ * thermal throttling) happen and how long they last
+ *
+ * Each thread owns a LatencyTimeline, so recording needs no locks or atomics.
+ * Only a per-interval summary is kept, so memory grows by one small struct
+ * per interval.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../common.h"
+#include "result_writer.h"
+
+/// The latency summary of one interval. An interval with no completed ops has
+/// count zero, which marks a stall longer than the interval.
+struct LatencyInterval {
+  double start_ms;  // Since the timeline's start
+  size_t count;
+  double mean_ns;
+  double p50_ns;
+  double p99_ns;
+  double p9999_ns;
+  double max_ns;
+};
+
+class LatencyTimeline {
+ public:
+  /**
+   * @param start_tsc The TSC at which interval zero begins. Threads that
+   * share it get aligned intervals.
+   */
+  LatencyTimeline(double freq_ghz, double interval_ms, size_t start_tsc)
+      : freq_ghz(freq_ghz),
+        interval_cycles(static_cast<size_t>(interval_ms * freq_ghz * 1e6)),
+        interval_start_tsc(start_tsc),
+        start_tsc(start_tsc) {
+    rt_assert(interval_cycles > 0, "Invalid timeline interval");
+    reset_interval();
+  }
+
+  /// Record an op that took \p cycles and completed at \p end_tsc
+  inline void record(size_t cycles, size_t end_tsc) {
+    while (end_tsc >= interval_start_tsc + interval_cycles) close_interval();
+    buckets[bucket_of(cycles)]++;
+    count++;
+    sum_cycles += cycles;
+    if (cycles > max_cycles) max_cycles = cycles;
+  }
+
+  /// Close intervals up to the one containing \p end_tsc, and that one too
+  void finish(size_t end_tsc) {
+    while (end_tsc >= interval_start_tsc + interval_cycles) close_interval();
+    if (count > 0) close_interval();
+  }
+
+  const std::vector<LatencyInterval> &get_intervals() const {
+    return intervals;
+  }
+
+  /// Write one row per interval, prefixed by the fields in \p prefix
+  void write_rows(ResultWriter &writer, const ResultRow &prefix) const {
+    for (const LatencyInterval &iv : intervals) {
+      ResultRow row = prefix;
+      row.add("interval_start_ms", iv.start_ms).add("count", iv.count);
+      row.add("mean_ns", iv.mean_ns).add("p50_ns", iv.p50_ns);
+      row.add("p99_ns", iv.p99_ns).add("p9999_ns", iv.p9999_ns);
+      row.add("max_ns", iv.max_ns);
+      writer.write(row);
+    }
+  }
+
+ private:
+  // Log-linear buckets: values below kSubBuckets are exact, and each larger
+  // power of two is split into kSubBuckets buckets, for ~3% relative error
+  static constexpr size_t kSubBucketBits = 5;
+  static constexpr size_t kSubBuckets = 1ull << kSubBucketBits;
+  static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  static inline size_t bucket_of(size_t v) {
+    if (v < kSubBuckets) return v;
+    const size_t exp = 63 - static_cast<size_t>(__builtin_clzll(v));
+    const size_t sub = (v >> (exp - kSubBucketBits)) & (kSubBuckets - 1);
+    return (exp - kSubBucketBits + 1) * kSubBuckets + sub;
+  }
+
+  /// The largest value in bucket \p b
+  static size_t bucket_max(size_t b) {
+    if (b < kSubBuckets) return b;
+    const size_t exp = b / kSubBuckets + kSubBucketBits - 1;
+    const size_t width = 1ull << (exp - kSubBucketBits);
+    return (kSubBuckets + b % kSubBuckets) * width + width - 1;
+  }
+
+  /// Return the value at percentile \p p of the current interval, in cycles
+  size_t percentile(double p) const {
+    const size_t target =
+        std::max(static_cast<size_t>(1), static_cast<size_t>(count * p / 100));
+    size_t seen = 0;
+    for (size_t b = 0; b < kNumBuckets; b++) {
+      seen += buckets[b];
+      if (seen >= target) return std::min(bucket_max(b), max_cycles);
+    }
+    return max_cycles;
+  }
+
+  void close_interval() {
+    LatencyInterval iv;
+    iv.start_ms = (interval_start_tsc - start_tsc) / (freq_ghz * 1e6);
+    iv.count = count;
+    iv.mean_ns = count > 0 ? sum_cycles / (count * freq_ghz) : 0.0;
+    iv.p50_ns = count > 0 ? percentile(50) / freq_ghz : 0.0;
+    iv.p99_ns = count > 0 ? percentile(99) / freq_ghz : 0.0;
+    iv.p9999_ns = count > 0 ? percentile(99.99) / freq_ghz : 0.0;
+    iv.max_ns = max_cycles / freq_ghz;
+    intervals.push_back(iv);
+
+    interval_start_tsc += interval_cycles;
+    reset_interval();
+  }
+
+  void reset_interval() {
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    sum_cycles = 0.0;
+    max_cycles = 0;
+  }
+
+  const double freq_ghz;
+  const size_t interval_cycles;
+  size_t interval_start_tsc;
+  const size_t start_tsc;
+
+  uint32_t buckets[kNumBuckets];
+  size_t count;
+  double sum_cycles;
+  size_t max_cycles;
+  std::vector<LatencyInterval> intervals;
+};
@@ -0,0 +1,111 @@
+/**
+ * @file numa_topology.h
+ * @brief Find the NUMA node of a pmem region from sysfs, the distances
+ * between nodes from libnuma, and the nearest cores to a region
+ */
+#pragma once
+
+#include <numa.h>
+#include <numaif.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fstream>
+#include <string>
+
+/// Return the integer in sysfs file \p path, or -1 if it can't be read
+static int read_sysfs_int(const std::string &path) {
+  std::ifstream file(path);
+  int value;
+  if (!(file >> value)) return -1;
+  return value;
+}
+
+/**
+ * @brief Return the NUMA node of the pmem named by region spec \p spec, or -1
+ * if it's unknown, e.g., for emulated regions
+ *
+ * devdax devices have a numa_node attribute in sysfs. For fsdax files, the
+ * node is that of the pmem block device holding the file.
+ */
+static int get_pmem_numa_node(const std::string &spec) {
+  if (spec.compare(0, 5, "emul:") == 0) return -1;
+
+  if (spec.find("/dev/dax") == 0) {
+    const std::string dev = spec.substr(5);  // e.g., dax0.0
+    int node = read_sysfs_int("/sys/bus/dax/devices/" + dev + "/numa_node");
+    if (node < 0) {
+      node = read_sysfs_int("/sys/bus/dax/devices/" + dev + "/target_node");
+    }
+    return node;
+  }
+
+  struct stat st;
+  if (stat(spec.c_str(), &st) != 0) return -1;
+  const std::string block_dir = "/sys/dev/block/" +
+                                std::to_string(major(st.st_dev)) + ":" +
+                                std::to_string(minor(st.st_dev));
+  int node = read_sysfs_int(block_dir + "/device/numa_node");
+  if (node < 0) {
+    node = read_sysfs_int(block_dir + "/../device/numa_node");  // A partition
+  }
+  return node;
+}
+
+/// Return the NUMA node of the page at \p addr, which must be faulted in, or
+/// -1 on error. This locates emulated regions, which live in DRAM.
+static int get_addr_numa_node(void *addr) {
+  int node = -1;
+  if (get_mempolicy(&node, nullptr, 0, addr, MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+    return -1;
+  }
+  return node;
+}
+
+/// Return the NUMA distance between two nodes, or -1 if a node is unknown
+static int get_numa_distance(int node_a, int node_b) {
+  if (node_a < 0 || node_b < 0) return -1;
+  return numa_distance(node_a, node_b);
+}
+
+/// Return true iff NUMA node \p node has CPUs. A devdax target_node is often
+/// a CPU-less memory-only node.
+static bool numa_node_has_cpus(int node) {
+  const int num_cpus = numa_num_configured_cpus();
+  for (int cpu = 0; cpu < num_cpus; cpu++) {
+    if (numa_node_of_cpu(cpu) == node) return true;
+  }
+  return false;
+}
+
+/// Return the node with CPUs that is nearest to \p node, or 0 if \p node is
+/// unknown
+static size_t get_nearest_cpu_node(int node) {
+  if (node < 0) return 0;
+  if (numa_node_has_cpus(node)) return static_cast<size_t>(node);
+
+  int best = 0, best_distance = -1;
+  for (int n = 0; n <= numa_max_node(); n++) {
+    if (!numa_node_has_cpus(n)) continue;
+    const int distance = numa_distance(node, n);
+    if (distance > 0 && (best_distance < 0 || distance < best_distance)) {
+      best = n;
+      best_distance = distance;
+    }
+  }
+  return static_cast<size_t>(best);
+}
+
+/**
+ * @brief Return the node whose cores should access the region named by
+ * \p spec and mapped at \p buf: the pmem's node, or for emulated regions the
+ * node of the page at \p buf, which must be faulted in. If that node has no
+ * CPUs, the nearest node with CPUs is returned.
+ */
+static size_t get_region_cpu_node(const std::string &spec, void *buf) {
+  int node = get_pmem_numa_node(spec);
+  if (node < 0 && spec.compare(0, 5, "emul:") == 0) {
+    node = get_addr_numa_node(buf);
+  }
+  return get_nearest_cpu_node(node);
+}
@@ -0,0 +1,125 @@
+/**
+ * @file open_loop.h
+ * @brief Open-loop load generation. Ops are scheduled at a target rate,
+ * independent of when earlier ops finish, and latency is measured from each
+ * op's scheduled start. This counts queueing delay that closed-loop
+ * benchmarks hide (coordinated omission).
+ */
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../common.h"
+
+/// Generates the scheduled start times of ops, in TSC cycles
+class ArrivalGenerator {
+ public:
+  enum class Type { kConstant, kPoisson };
+
+  static Type parse_type(const std::string &str) {
+    if (str == "constant") return Type::kConstant;
+    if (str == "poisson") return Type::kPoisson;
+    throw std::runtime_error("Invalid arrival type " + str);
+  }
+
+  /**
+   * @param rate_mops The offered load in millions of ops per second
+   * @param start_tsc The TSC at which the first op is scheduled
+   */
+  ArrivalGenerator(Type type, double rate_mops, double freq_ghz,
+                   size_t start_tsc)
+      : type(type),
+        mean_gap_cycles(freq_ghz * 1000.0 / rate_mops),
+        next_tsc(static_cast<double>(start_tsc)) {
+    rt_assert(rate_mops > 0, "Open-loop rate must be positive");
+  }
+
+  /// Return the scheduled start of the next op
+  inline size_t peek() const { return static_cast<size_t>(next_tsc); }
+
+  /// Return the scheduled start of the next op, and advance past it
+  inline size_t next() {
+    const size_t ret = peek();
+    if (type == Type::kConstant) {
+      next_tsc += mean_gap_cycles;
+    } else {
+      // Exponential gaps. 1 - U is in (0, 1], so log() is finite.
+      next_tsc += -log(1.0 - uniform(rand_gen)) * mean_gap_cycles;
+    }
+    return ret;
+  }
+
+ private:
+  const Type type;
+  const double mean_gap_cycles;
+  double next_tsc;
+  std::mt19937_64 rand_gen{std::random_device{}()};
+  std::uniform_real_distribution<double> uniform{0.0, 1.0};
+};
+
+/// The result of running at one offered load
+struct OpenLoopResult {
+  double offered_mops;
+  double achieved_mops;
+  double avg_ns;
+  double p50_ns;
+  double p99_ns;
+  double p999_ns;
+};
+
+/// Summarize per-op latencies in cycles, measured from the scheduled starts.
+/// \p latency_vec is sorted in place.
+static OpenLoopResult summarize_open_loop(std::vector<size_t> &latency_vec,
+                                          double offered_mops,
+                                          double elapsed_ns, double freq_ghz) {
+  rt_assert(!latency_vec.empty(), "No open-loop latency samples");
+  std::sort(latency_vec.begin(), latency_vec.end());
+
+  OpenLoopResult result;
+  result.offered_mops = offered_mops;
+  result.achieved_mops = latency_vec.size() * 1000.0 / elapsed_ns;
+  double sum = 0;
+  for (size_t latency : latency_vec) sum += latency;
+  result.avg_ns = sum / (latency_vec.size() * freq_ghz);
+  result.p50_ns = latency_vec.at(latency_vec.size() / 2) / freq_ghz;
+  result.p99_ns = latency_vec.at(latency_vec.size() * 99 / 100) / freq_ghz;
+  result.p999_ns = latency_vec.at(latency_vec.size() * 999 / 1000) / freq_ghz;
+  return result;
+}
+
+/**
+ * @brief Run \p num_ops calls of \p op at an offered load of \p rate_mops
+ *
+ * An op starts at its scheduled time, or right away if earlier ops have made
+ * it late. Its latency includes the lateness.
+ */
+template <class Op>
+OpenLoopResult run_open_loop(Op op, size_t num_ops,
+                             ArrivalGenerator::Type type, double rate_mops,
+                             double freq_ghz) {
+  std::vector<size_t> latency_vec;
+  latency_vec.reserve(num_ops);
+
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  ArrivalGenerator arrivals(type, rate_mops, freq_ghz, rdtsc());
+
+  for (size_t i = 0; i < num_ops; i++) {
+    const size_t scheduled_tsc = arrivals.next();
+    while (rdtsc() < scheduled_tsc) {
+      // Wait for the op's scheduled start
+    }
+
+    op();
+    latency_vec.push_back(rdtsc() - scheduled_tsc);
+  }
+
+  return summarize_open_loop(latency_vec, rate_mops, ns_since(start),
+                             freq_ghz);
+}
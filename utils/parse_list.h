@@ -0,0 +1,54 @@
+/**
+ * @file parse_list.h
+ * @brief Parse the comma-separated lists that benchmark flags take, e.g.,
+ * --sizes=64,4K,2M. Header-only.
+ */
+#pragma once
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../common.h"
+
+/// Split \p str at commas. Empty items are skipped.
+static std::vector<std::string> parse_str_list(const std::string &str) {
+  std::vector<std::string> ret;
+  std::istringstream ss(str);
+  std::string token;
+  while (std::getline(ss, token, ',')) {
+    if (!token.empty()) ret.push_back(token);
+  }
+  return ret;
+}
+
+/// Parse a size with an optional K, M or G suffix for powers of 1024
+static size_t parse_size(const std::string &str) {
+  size_t suffix_pos = 0;
+  const size_t value = std::stoull(str, &suffix_pos);
+  const std::string suffix = str.substr(suffix_pos);
+
+  if (suffix.empty()) return value;
+  if (suffix == "K" || suffix == "k") return KB(value);
+  if (suffix == "M" || suffix == "m") return MB(value);
+  if (suffix == "G" || suffix == "g") return GB(value);
+  throw std::runtime_error("Invalid size " + str);
+}
+
+/// Parse a comma-separated list of sizes or counts, e.g., "64,4K,2M,1G"
+static std::vector<size_t> parse_size_list(const std::string &str) {
+  std::vector<size_t> ret;
+  for (const std::string &token : parse_str_list(str)) {
+    ret.push_back(parse_size(token));
+  }
+  return ret;
+}
+
+/// Parse a comma-separated list of real numbers, e.g., rates
+static std::vector<double> parse_double_list(const std::string &str) {
+  std::vector<double> ret;
+  for (const std::string &token : parse_str_list(str)) {
+    ret.push_back(std::stod(token));
+  }
+  return ret;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file pmem_copy.h
+ * @brief In-repo copy kernels for persistent writes, as an alternative to
+ * libpmem's pmem_memcpy_*
+ *
+ * Large copies use AVX2 or AVX-512 non-temporal stores, with the head copied
+ * with cached stores and clwb up to a 256-byte XPLine boundary, so that the
+ * non-temporal stores always fill whole XPLines. Small copies use cached
+ * stores and clwb. The ISA is picked at runtime with CPUID, and the kernels
+ * are compiled with target attributes, so they build without -march=native.
+ *
+ * Data structures take a copy policy (LibpmemCopy or SimdCopy) as a template
+ * parameter. Self-contained, so that it can be used by the KV tables, which
+ * don't include common.h.
+ */
+#pragma once
+
+#include <immintrin.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include "cpuid.h"
+
+namespace pmem_copy {
+
+static constexpr size_t kXPLineSize = 256;
+
+/// Below this many bytes, SimdCopy uses cached stores and clwb
+static constexpr size_t kNtThreshold = 256;
+
+enum class Isa { kAvx2, kAvx512 };
+
+/**
+ * @brief Copy \p num_lines cachelines with AVX2 non-temporal stores, without
+ * a fence. \p dst must be 64-byte aligned, and \p num_lines a multiple of
+ * kUnroll.
+ *
+ * @tparam kUnroll Cachelines per loop iteration
+ * @tparam kLoadsFirst If true, each iteration issues all its loads before its
+ * stores. Else, loads and stores alternate.
+ */
+template <size_t kUnroll, bool kLoadsFirst>
+__attribute__((target("avx2"))) void nt_lines_avx2(uint8_t *dst,
+                                                   const uint8_t *src,
+                                                   size_t num_lines) {
+  static constexpr size_t kVecs = kUnroll * 2;  // 32-byte vectors
+  for (size_t i = 0; i < num_lines; i += kUnroll) {
+    auto *d = reinterpret_cast<__m256i *>(dst);
+    auto *s = reinterpret_cast<const __m256i *>(src);
+    if (kLoadsFirst) {
+      __m256i v[kVecs];
+      for (size_t j = 0; j < kVecs; j++) v[j] = _mm256_loadu_si256(&s[j]);
+      for (size_t j = 0; j < kVecs; j++) _mm256_stream_si256(&d[j], v[j]);
+    } else {
+      for (size_t j = 0; j < kVecs; j++) {
+        _mm256_stream_si256(&d[j], _mm256_loadu_si256(&s[j]));
+      }
+    }
+    dst += kUnroll * 64;
+    src += kUnroll * 64;
+  }
+}
+
+/// The AVX-512 version of nt_lines_avx2
+template <size_t kUnroll, bool kLoadsFirst>
+__attribute__((target("avx512f"))) void nt_lines_avx512(uint8_t *dst,
+                                                       const uint8_t *src,
+                                                       size_t num_lines) {
+  for (size_t i = 0; i < num_lines; i += kUnroll) {
+    if (kLoadsFirst) {
+      __m512i v[kUnroll];
+      for (size_t j = 0; j < kUnroll; j++) {
+        v[j] = _mm512_loadu_si512(src + j * 64);
+      }
+      for (size_t j = 0; j < kUnroll; j++) {
+        _mm512_stream_si512(reinterpret_cast<__m512i *>(dst + j * 64), v[j]);
+      }
+    } else {
+      for (size_t j = 0; j < kUnroll; j++) {
+        _mm512_stream_si512(reinterpret_cast<__m512i *>(dst + j * 64),
+                            _mm512_loadu_si512(src + j * 64));
+      }
+    }
+    dst += kUnroll * 64;
+    src += kUnroll * 64;
+  }
+}
+
+/// clwb the cachelines of [addr, end)
+__attribute__((target("clwb"))) static void clwb_lines(uintptr_t addr,
+                                                       uintptr_t end) {
+  for (uintptr_t line = addr & ~uintptr_t(63); line < end; line += 64) {
+    _mm_clwb(reinterpret_cast<void *>(line));
+  }
+}
+
+/// Flush the cachelines of [addr, addr + len) with clwb, or libpmem's choice
+/// of flush if the CPU lacks clwb. Doesn't fence.
+static inline void flush_range(const uint8_t *addr, size_t len) {
+  static const bool has_clwb = get_cpu_features().clwb;
+  if (len == 0) return;
+  if (has_clwb) {
+    const auto start = reinterpret_cast<uintptr_t>(addr);
+    clwb_lines(start, start + len);
+  } else {
+    pmem_flush(addr, len);
+  }
+}
+
+/// Copy with cached stores and clwb, without a fence
+static inline void copy_clwb_nodrain(void *dst, const void *src, size_t len) {
+  memcpy(dst, src, len);
+  flush_range(static_cast<const uint8_t *>(dst), len);
+}
+
+/**
+ * @brief Copy with non-temporal stores, without a fence. The head up to the
+ * next XPLine boundary, and the tail of fewer than kUnroll cachelines, use
+ * cached stores and clwb.
+ */
+template <Isa kIsa, size_t kUnroll, bool kLoadsFirst>
+void copy_nt_nodrain(void *dst, const void *src, size_t len) {
+  auto *d = static_cast<uint8_t *>(dst);
+  auto *s = static_cast<const uint8_t *>(src);
+
+  const size_t misalign = reinterpret_cast<uintptr_t>(d) % kXPLineSize;
+  const size_t head = std::min(len, (kXPLineSize - misalign) % kXPLineSize);
+  copy_clwb_nodrain(d, s, head);
+  d += head;
+  s += head;
+  len -= head;
+
+  const size_t num_lines = len / 64 / kUnroll * kUnroll;
+  if (kIsa == Isa::kAvx512) {
+    nt_lines_avx512<kUnroll, kLoadsFirst>(d, s, num_lines);
+  } else {
+    nt_lines_avx2<kUnroll, kLoadsFirst>(d, s, num_lines);
+  }
+  d += num_lines * 64;
+  s += num_lines * 64;
+  len -= num_lines * 64;
+
+  copy_clwb_nodrain(d, s, len);
+}
+
+typedef void (*CopyFunc)(void *, const void *, size_t);
+
+static void copy_libpmem_nodrain(void *dst, const void *src, size_t len) {
+  pmem_memcpy_nodrain(dst, src, len);
+}
+
+/// Return the fastest non-temporal kernel that this CPU supports, or
+/// libpmem's copy if it has neither AVX2 nor AVX-512
+static CopyFunc select_nt_kernel() {
+  const CpuFeatures features = get_cpu_features();
+  if (features.avx512f) return copy_nt_nodrain<Isa::kAvx512, 4, true>;
+  if (features.avx2) return copy_nt_nodrain<Isa::kAvx2, 4, true>;
+  return copy_libpmem_nodrain;
+}
+
+}  // namespace pmem_copy
+
+/// Copy policy that uses libpmem
+struct LibpmemCopy {
+  static inline void copy_nodrain(void *dst, const void *src, size_t len) {
+    pmem_memcpy_nodrain(dst, src, len);
+  }
+
+  static inline void copy_persist(void *dst, const void *src, size_t len) {
+    pmem_memcpy_persist(dst, src, len);
+  }
+
+  static inline void drain() { pmem_drain(); }
+};
+
+/// Copy policy that uses this file's kernels, picked by size and CPUID
+struct SimdCopy {
+  static inline void copy_nodrain(void *dst, const void *src, size_t len) {
+    static const pmem_copy::CopyFunc nt_kernel = pmem_copy::select_nt_kernel();
+    if (len < pmem_copy::kNtThreshold) {
+      pmem_copy::copy_clwb_nodrain(dst, src, len);
+    } else {
+      nt_kernel(dst, src, len);
+    }
+  }
+
+  static inline void copy_persist(void *dst, const void *src, size_t len) {
+    copy_nodrain(dst, src, len);
+    drain();
+  }
+
+  /// Both clwb and non-temporal stores are ordered by an sfence
+  static inline void drain() { _mm_sfence(); }
+};
@@ -0,0 +1,240 @@
+/**
+ * @file pmem_region.h
+ * @brief Map a persistent memory region from devdax, fsdax, or an emulated
+ * backend for hosts without pmem. Header-only, depends only on libpmem.
+ *
+ * A region is named by a spec string:
+ *  - "/dev/daxX.Y": devdax, mapped with mmap
+ *  - "emul:dram": anonymous DRAM, backed by hugepages if available
+ *  - "emul:<path>": a regular file, e.g., on tmpfs. It is created or extended
+ *    to the requested length.
+ *  - Any other path: an fsdax file, mapped with pmem_map_file. This must be
+ *    real pmem.
+ *
+ * Tests map $PMEM_TEST_FILE, or emulated DRAM if it is unset, so that they run
+ * on hosts without pmem.
+ *
+ * Emulated specs can add a write performance model, e.g.,
+ * "emul:dram,write_ns=300,write_GBps=2". Persist points in the benchmarks
+ * call emul_persist_delay() with the bytes they persisted, which then waits
+ * for write_ns plus the bytes' transfer time at write_GBps. Loads are not
+ * slowed down. Without a model, emul_persist_delay() is a no-op.
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+enum class PmemBackend { kDevdax, kFsdax, kEmulDram, kEmulFile };
+
+static const char *pmem_backend_str(PmemBackend backend) {
+  switch (backend) {
+    case PmemBackend::kDevdax:
+      return "devdax";
+    case PmemBackend::kFsdax:
+      return "fsdax";
+    case PmemBackend::kEmulDram:
+      return "emul_dram";
+    case PmemBackend::kEmulFile:
+      return "emul_file";
+  }
+  return "invalid";
+}
+
+/// A mapped pmem region
+struct PmemRegion {
+  uint8_t *buf = nullptr;
+  size_t len = 0;  // Mapped bytes
+  PmemBackend backend = PmemBackend::kFsdax;
+
+  bool is_emulated() const {
+    return backend == PmemBackend::kEmulDram ||
+           backend == PmemBackend::kEmulFile;
+  }
+};
+
+/// The write performance model for emulated regions. Zero disables a term.
+struct PmemEmulModel {
+  double write_ns = 0.0;    // Added latency per persist
+  double write_GBps = 0.0;  // Bandwidth of each persisting thread
+  double tsc_per_ns = 0.0;  // Set when the model is enabled
+};
+
+static PmemEmulModel pmem_emul_model;
+static bool pmem_emul_model_enabled = false;
+
+/// Wait as if \p bytes were persisted to the emulated pmem
+static inline void emul_persist_delay(size_t bytes) {
+  if (__builtin_expect(!pmem_emul_model_enabled, 1)) return;
+
+  double ns = pmem_emul_model.write_ns;
+  if (pmem_emul_model.write_GBps > 0) {
+    ns += bytes / pmem_emul_model.write_GBps;  // 1 GB/s = 1 byte/ns
+  }
+
+  const uint64_t end_tsc =
+      __rdtsc() + static_cast<uint64_t>(ns * pmem_emul_model.tsc_per_ns);
+  while (__rdtsc() < end_tsc) _mm_pause();
+}
+
+/// Return TSC ticks per nanosecond, measured over 10 ms
+static double pmem_region_measure_tsc_per_ns() {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  const uint64_t start_tsc = __rdtsc();
+
+  double elapsed_ns;
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed_ns = (end.tv_sec - start.tv_sec) * 1000000000.0 +
+                 (end.tv_nsec - start.tv_nsec);
+  } while (elapsed_ns < 10000000);
+
+  return (__rdtsc() - start_tsc) / elapsed_ns;
+}
+
+static void pmem_region_check(bool condition, const std::string &msg) {
+  if (!condition) throw std::runtime_error("PmemRegion: " + msg);
+}
+
+/// Parse the ",key=value" model options of an emulated spec
+static void pmem_region_parse_model(const std::string &options) {
+  std::istringstream ss(options);
+  std::string option;
+  while (std::getline(ss, option, ',')) {
+    if (option.empty()) continue;
+    const size_t eq = option.find('=');
+    pmem_region_check(eq != std::string::npos, "invalid option " + option);
+
+    const std::string key = option.substr(0, eq);
+    const double value = std::stod(option.substr(eq + 1));
+    if (key == "write_ns") {
+      pmem_emul_model.write_ns = value;
+    } else if (key == "write_GBps") {
+      pmem_emul_model.write_GBps = value;
+    } else {
+      pmem_region_check(false, "unknown option " + key);
+    }
+  }
+
+  pmem_emul_model_enabled =
+      pmem_emul_model.write_ns > 0 || pmem_emul_model.write_GBps > 0;
+  if (pmem_emul_model_enabled) {
+    pmem_emul_model.tsc_per_ns = pmem_region_measure_tsc_per_ns();
+  }
+}
+
+/**
+ * @brief Map the region named by \p spec
+ *
+ * @param len The bytes needed. Zero maps a whole fsdax or emulated file, and
+ * is not allowed for devdax or DRAM. Mapping throws if the region is smaller.
+ */
+static PmemRegion map_pmem_region(const std::string &spec, size_t len) {
+  PmemRegion region;
+
+  if (spec.compare(0, 5, "emul:") == 0) {
+    const size_t comma = spec.find(',');
+    const std::string path = spec.substr(5, comma - 5);
+    if (comma != std::string::npos) {
+      pmem_region_parse_model(spec.substr(comma + 1));
+    }
+
+    if (path == "dram") {
+      pmem_region_check(len > 0, "emulated DRAM needs a length");
+      region.backend = PmemBackend::kEmulDram;
+      region.len = (len + (1ull << 21) - 1) & ~((1ull << 21) - 1);
+
+      void *buf = mmap(nullptr, region.len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (buf == MAP_FAILED) {
+        // No reserved hugepages. Ask for transparent hugepages instead, and
+        // don't reserve swap so that regions larger than DRAM can be mapped.
+        buf = mmap(nullptr, region.len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        pmem_region_check(buf != MAP_FAILED, "DRAM mmap failed");
+        madvise(buf, region.len, MADV_HUGEPAGE);
+      }
+      region.buf = static_cast<uint8_t *>(buf);
+    } else {
+      region.backend = PmemBackend::kEmulFile;
+      int fd = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+      pmem_region_check(fd >= 0, "open failed for " + path + ": " +
+                                     std::string(strerror(errno)));
+
+      struct stat st;
+      pmem_region_check(fstat(fd, &st) == 0, "fstat failed for " + path);
+      const size_t file_size = static_cast<size_t>(st.st_size);
+      if (file_size < len) {
+        pmem_region_check(ftruncate(fd, static_cast<off_t>(len)) == 0,
+                          "ftruncate failed for " + path);
+      }
+      region.len = len > 0 ? len : file_size;
+      pmem_region_check(region.len > 0, "empty file " + path);
+
+      void *buf = mmap(nullptr, region.len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+      close(fd);
+      pmem_region_check(buf != MAP_FAILED, "file mmap failed for " + path);
+      region.buf = static_cast<uint8_t *>(buf);
+    }
+  } else if (spec.find("/dev/dax") == 0) {
+    pmem_region_check(len > 0, "devdax needs a length");
+    region.backend = PmemBackend::kDevdax;
+    region.len = (len + (1ull << 21) - 1) & ~((1ull << 21) - 1);
+
+    int fd = open(spec.c_str(), O_RDWR);
+    pmem_region_check(fd >= 0, "devdax open failed for " + spec);
+    void *buf =
+        mmap(nullptr, region.len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    pmem_region_check(buf != MAP_FAILED, "devdax mmap failed for " + spec);
+    region.buf = static_cast<uint8_t *>(buf);
+  } else {
+    region.backend = PmemBackend::kFsdax;
+    int is_pmem;
+    region.buf = static_cast<uint8_t *>(pmem_map_file(
+        spec.c_str(), 0 /* length */, 0 /* flags */, 0666, &region.len,
+        &is_pmem));
+    pmem_region_check(region.buf != nullptr,
+                      "pmem_map_file() failed for " + spec + ": " +
+                          std::string(strerror(errno)));
+    pmem_region_check(is_pmem == 1,
+                      spec + " is not pmem. Use emul:" + spec + " instead.");
+  }
+
+  pmem_region_check(region.len >= len,
+                    spec + " too small: " + std::to_string(len) +
+                        " bytes needed, " + std::to_string(region.len) +
+                        " available");
+  pmem_region_check(reinterpret_cast<size_t>(region.buf) % 4096 == 0,
+                    "mapped buffer isn't page-aligned");
+  return region;
+}
+
+static void unmap_pmem_region(const PmemRegion &region) {
+  if (region.buf == nullptr) return;
+  if (region.backend == PmemBackend::kFsdax) {
+    pmem_unmap(region.buf, region.len);
+  } else {
+    munmap(region.buf, region.len);
+  }
+}
+
+/// The region spec for tests: $PMEM_TEST_FILE, or emulated DRAM if unset
+static std::string get_test_pmem_spec() {
+  const char *spec = getenv("PMEM_TEST_FILE");
+  return spec != nullptr ? spec : "emul:dram";
+}
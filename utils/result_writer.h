@@ -0,0 +1,206 @@
+/**
+ * @file result_writer.h
+ * @brief Emit benchmark results as CSV or JSON rows, preceded by metadata
+ * about the host, so that results from different machines can be diffed
+ */
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../common.h"
+
+/// One row of results: an ordered list of named fields
+class ResultRow {
+ public:
+  ResultRow &add(const std::string &key, const std::string &value) {
+    fields.push_back(Field(key, value, true /* is_string */));
+    return *this;
+  }
+
+  ResultRow &add(const std::string &key, const char *value) {
+    return add(key, std::string(value));
+  }
+
+  ResultRow &add(const std::string &key, size_t value) {
+    fields.push_back(Field(key, std::to_string(value), false));
+    return *this;
+  }
+
+  ResultRow &add(const std::string &key, double value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.3f", value);
+    fields.push_back(Field(key, buf, false));
+    return *this;
+  }
+
+  struct Field {
+    Field(const std::string &key, const std::string &value, bool is_string)
+        : key(key), value(value), is_string(is_string) {}
+    std::string key;
+    std::string value;
+    bool is_string;
+  };
+
+  std::vector<Field> fields;
+};
+
+/// Return a metadata row describing this host
+static ResultRow get_host_metadata() {
+  ResultRow row;
+
+  char hostname[256] = {0};
+  gethostname(hostname, sizeof(hostname) - 1);
+  row.add("hostname", hostname);
+
+  struct utsname uts;
+  if (uname(&uts) == 0) row.add("kernel", uts.release);
+
+  // The first "model name" line in /proc/cpuinfo
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") != 0) continue;
+    size_t colon = line.find(':');
+    if (colon != std::string::npos && colon + 2 <= line.size()) {
+      row.add("cpu_model", line.substr(colon + 2));
+    }
+    break;
+  }
+
+  row.add("numa_nodes", static_cast<size_t>(numa_num_configured_nodes()));
+  row.add("lcores_per_numa_node", num_lcores_per_numa_node());
+
+  char time_buf[64];
+  time_t now = time(nullptr);
+  strftime(time_buf, sizeof(time_buf), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  row.add("timestamp", time_buf);
+  return row;
+}
+
+/**
+ * @brief Writes result rows to stdout or a file
+ *
+ * CSV output starts with the metadata as "# key: value" comment lines, and
+ * prints a header line whenever the set of columns changes. JSON output has
+ * one object per line: the metadata object has "type": "metadata", and result
+ * objects have "type": "result".
+ */
+class ResultWriter {
+ public:
+  enum class Format { kCsv, kJson };
+
+  /**
+   * @param format "csv" or "json"
+   *
+   * @param output_file Results are appended to this file. If empty, results
+   * are written to stdout.
+   */
+  ResultWriter(const std::string &format, const std::string &output_file) {
+    if (format == "csv") {
+      this->format = Format::kCsv;
+    } else if (format == "json") {
+      this->format = Format::kJson;
+    } else {
+      throw std::runtime_error("ResultWriter: invalid format " + format);
+    }
+
+    if (output_file.empty()) {
+      out = stdout;
+    } else {
+      out = fopen(output_file.c_str(), "a");
+      rt_assert(out != nullptr, "ResultWriter: failed to open " + output_file);
+    }
+  }
+
+  ~ResultWriter() {
+    if (out != stdout) fclose(out);
+  }
+
+  /// Write the metadata. Extra fields, e.g., the pmem file, come after the
+  /// host's fields.
+  void write_metadata(const ResultRow &extra) {
+    ResultRow row = get_host_metadata();
+    for (auto &field : extra.fields) row.fields.push_back(field);
+
+    if (format == Format::kCsv) {
+      for (auto &field : row.fields) {
+        fprintf(out, "# %s: %s\n", field.key.c_str(), field.value.c_str());
+      }
+    } else {
+      write_json(row, "metadata");
+    }
+    fflush(out);
+  }
+
+  /// Write one result row
+  void write(const ResultRow &row) {
+    if (format == Format::kCsv) {
+      std::string header;
+      for (auto &field : row.fields) {
+        header += (header.empty() ? "" : ",") + field.key;
+      }
+      if (header != prev_csv_header) {
+        fprintf(out, "%s\n", header.c_str());
+        prev_csv_header = header;
+      }
+
+      std::string line;
+      for (size_t i = 0; i < row.fields.size(); i++) {
+        line += (i == 0 ? "" : ",") + csv_escape(row.fields[i].value);
+      }
+      fprintf(out, "%s\n", line.c_str());
+    } else {
+      write_json(row, "result");
+    }
+    fflush(out);
+  }
+
+ private:
+  static std::string csv_escape(const std::string &s) {
+    if (s.find_first_of(",\"\n") == std::string::npos) return s;
+    std::string ret = "\"";
+    for (char c : s) {
+      if (c == '"') ret += '"';  // Quotes are escaped by doubling them
+      ret += c;
+    }
+    return ret + "\"";
+  }
+
+  static std::string json_escape(const std::string &s) {
+    std::string ret;
+    for (char c : s) {
+      if (c == '"' || c == '\\') {
+        ret += '\\';
+        ret += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        ret += buf;
+      } else {
+        ret += c;
+      }
+    }
+    return ret;
+  }
+
+  void write_json(const ResultRow &row, const char *type) {
+    std::string line = std::string("{\"type\": \"") + type + "\"";
+    for (auto &field : row.fields) {
+      line += ", \"" + json_escape(field.key) + "\": ";
+      line += field.is_string ? "\"" + json_escape(field.value) + "\""
+                              : field.value;
+    }
+    fprintf(out, "%s}\n", line.c_str());
+  }
+
+  Format format;
+  FILE *out;
+  std::string prev_csv_header;
+};
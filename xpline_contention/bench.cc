@@ -0,0 +1,240 @@
+/**
+ * @file bench.cc
+ * @brief Persist rate when several threads update nearby pmem metadata
+ *
+ * Each thread repeatedly stores to an 8-byte counter and persists it. The
+ * sharing pattern places the counters:
+ *  - same_line: all counters in one cacheline
+ *  - same_xpline: one cacheline per thread, four threads per 256-byte XPLine
+ *  - diff_xpline: one XPLine per thread
+ *
+ * The results show how much padding shared persistent metadata needs. Threads
+ * run for a fixed time, and each row reports the total and per-thread rates.
+ */
+
+#include <gflags/gflags.h>
+#include <immintrin.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "../common.h"
+#include "../utils/cpuid.h"
+#include "../utils/ipmctl.h"
+#include "../utils/numa_topology.h"
+#include "../utils/parse_list.h"
+#include "../utils/pmem_region.h"
+#include "../utils/result_writer.h"
+
+DEFINE_string(pmem_file, "/dev/dax0.0",
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram");
+DEFINE_string(threads, "1,2,4,8,16", "Comma-separated thread counts");
+DEFINE_string(sharing, "same_line,same_xpline,diff_xpline",
+              "Comma-separated counter placements: same_line, same_xpline, or "
+              "diff_xpline");
+DEFINE_string(methods, "clwb,clflushopt,ntstore",
+              "Comma-separated persist methods: clwb, clflushopt, or ntstore");
+DEFINE_double(duration_sec, 2.0, "Run time per configuration");
+DEFINE_bool(ipmctl, true, "Report the media write ratio if ipmctl works");
+DEFINE_string(format, "csv", "Result format: csv or json");
+DEFINE_string(output_file, "",
+              "Append results to this file. Empty means stdout.");
+
+static constexpr size_t kXPLineSize = 256;
+static constexpr size_t kLinesPerXPLine = kXPLineSize / 64;
+static constexpr size_t kRegionSize = MB(2);
+
+enum class Sharing { kSameLine, kSameXPLine, kDiffXPLine };
+enum class Method { kClwb, kClflushopt, kNtStore };
+
+static Sharing parse_sharing(const std::string &str) {
+  if (str == "same_line") return Sharing::kSameLine;
+  if (str == "same_xpline") return Sharing::kSameXPLine;
+  if (str == "diff_xpline") return Sharing::kDiffXPLine;
+  throw std::runtime_error("Invalid sharing pattern " + str);
+}
+
+static Method parse_method(const std::string &str) {
+  if (str == "clwb") return Method::kClwb;
+  if (str == "clflushopt") return Method::kClflushopt;
+  if (str == "ntstore") return Method::kNtStore;
+  throw std::runtime_error("Invalid persist method " + str);
+}
+
+/// Return the byte offset of thread \p thread_id's counter. Past eight
+/// threads, same_line threads share counters.
+static size_t counter_offset(Sharing sharing, size_t thread_id) {
+  switch (sharing) {
+    case Sharing::kSameLine:
+      return (thread_id % 8) * sizeof(size_t);
+    case Sharing::kSameXPLine:
+      return (thread_id / kLinesPerXPLine) * kXPLineSize +
+             (thread_id % kLinesPerXPLine) * 64;
+    case Sharing::kDiffXPLine:
+      return thread_id * kXPLineSize;
+  }
+  return 0;
+}
+
+__attribute__((target("clwb"))) static void do_clwb(void *addr) {
+  _mm_clwb(addr);
+}
+
+__attribute__((target("clflushopt"))) static void do_clflushopt(void *addr) {
+  _mm_clflushopt(addr);
+}
+
+/// Shared run control. Threads start together once all are ready.
+struct RunControl {
+  std::atomic<size_t> num_ready{0};
+  std::atomic<bool> start{false};
+  std::atomic<bool> stop{false};
+};
+
+/// Persist increments of \p counter until told to stop
+template <Method kMethod>
+void contention_thread(size_t *counter, RunControl *control,
+                       size_t *num_persists) {
+  control->num_ready++;
+  while (!control->start.load(std::memory_order_acquire)) _mm_pause();
+
+  size_t i = 0;
+  while (!control->stop.load(std::memory_order_relaxed)) {
+    i++;
+    if (kMethod == Method::kNtStore) {
+      _mm_stream_si64(reinterpret_cast<long long *>(counter),
+                      static_cast<long long>(i));
+    } else {
+      *reinterpret_cast<volatile size_t *>(counter) = i;
+      if (kMethod == Method::kClwb) {
+        do_clwb(counter);
+      } else {
+        do_clflushopt(counter);
+      }
+    }
+    _mm_sfence();
+    emul_persist_delay(sizeof(size_t));
+  }
+
+  *num_persists = i;
+}
+
+static decltype(&contention_thread<Method::kClwb>) get_thread_func(
+    Method method) {
+  switch (method) {
+    case Method::kClwb:
+      return contention_thread<Method::kClwb>;
+    case Method::kClflushopt:
+      return contention_thread<Method::kClflushopt>;
+    case Method::kNtStore:
+      return contention_thread<Method::kNtStore>;
+  }
+  return nullptr;
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  const std::vector<size_t> thread_counts = parse_size_list(FLAGS_threads);
+  const std::vector<std::string> sharings = parse_str_list(FLAGS_sharing);
+  const std::vector<std::string> methods = parse_str_list(FLAGS_methods);
+  for (auto &sharing : sharings) parse_sharing(sharing);
+
+  // Skip methods that would fault
+  const CpuFeatures features = get_cpu_features();
+  std::vector<std::string> supported_methods;
+  for (auto &method : methods) {
+    const Method m = parse_method(method);
+    if ((m == Method::kClwb && !features.clwb) ||
+        (m == Method::kClflushopt && !features.clflushopt)) {
+      fprintf(stderr, "Skipping %s. The CPU doesn't support it.\n",
+              method.c_str());
+      continue;
+    }
+    supported_methods.push_back(method);
+  }
+
+  ResultWriter writer(FLAGS_format, FLAGS_output_file);
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, kRegionSize);
+  pmem_memset_persist(region.buf, 0, kRegionSize);  // Fault in pages
+
+  const size_t node = get_region_cpu_node(FLAGS_pmem_file, region.buf);
+  const size_t num_lcores = get_lcores_for_numa_node(node).size();
+
+  const bool use_ipmctl = FLAGS_ipmctl && read_dimm_counters().valid;
+  if (FLAGS_ipmctl && !use_ipmctl) {
+    fprintf(stderr, "ipmctl is unavailable. Not reporting media writes.\n");
+  }
+
+  ResultRow metadata;
+  metadata.add("pmem_file", FLAGS_pmem_file);
+  metadata.add("pmem_mode", pmem_backend_str(region.backend));
+  metadata.add("numa_node", node);
+  metadata.add("duration_sec", FLAGS_duration_sec);
+  writer.write_metadata(metadata);
+
+  for (auto &method : supported_methods) {
+    const auto thread_func = get_thread_func(parse_method(method));
+    for (auto &sharing : sharings) {
+      const Sharing sharing_type = parse_sharing(sharing);
+      for (size_t num_threads : thread_counts) {
+        rt_assert(num_threads > 0 && num_threads <= num_lcores,
+                  "Thread counts must be in [1, cores near the pmem]");
+        rt_assert(counter_offset(sharing_type, num_threads) <= kRegionSize,
+                  "Too many threads for the region");
+
+        const DimmCounters before =
+            use_ipmctl ? read_dimm_counters() : DimmCounters();
+
+        RunControl control;
+        std::vector<size_t> num_persists(num_threads);
+        std::vector<std::thread> threads(num_threads);
+        for (size_t i = 0; i < num_threads; i++) {
+          auto *counter = reinterpret_cast<size_t *>(
+              region.buf + counter_offset(sharing_type, i));
+          threads[i] = std::thread(thread_func, counter, &control,
+                                   &num_persists[i]);
+          bind_to_core(threads[i], node, i);
+        }
+
+        while (control.num_ready < num_threads) usleep(1000);
+        struct timespec start;
+        clock_gettime(CLOCK_REALTIME, &start);
+        control.start = true;
+        usleep(static_cast<useconds_t>(FLAGS_duration_sec * 1000000));
+        control.stop = true;
+        for (auto &t : threads) t.join();
+        const double seconds = sec_since(start);
+
+        const DimmCounters after =
+            use_ipmctl ? read_dimm_counters() : DimmCounters();
+
+        std::sort(num_persists.begin(), num_persists.end());
+        const size_t total =
+            std::accumulate(num_persists.begin(), num_persists.end(), 0ul);
+        const double to_mops = 1.0 / (seconds * 1000000);
+
+        ResultRow row;
+        row.add("method", method).add("sharing", sharing);
+        row.add("threads", num_threads);
+        row.add("total_Mops", total * to_mops);
+        row.add("per_thread_avg_Mops", total * to_mops / num_threads);
+        row.add("per_thread_min_Mops", num_persists.front() * to_mops);
+        row.add("per_thread_max_Mops", num_persists.back() * to_mops);
+        row.add("media_write_ratio", media_write_ratio(before, after));
+        writer.write(row);
+      }
+    }
+  }
+
+  unmap_pmem_region(region);
+  exit(0);
+}
@@ -0,0 +1,4 @@
+exe="./bench"
+chmod +x $exe
+
+sudo -E $exe "$@"
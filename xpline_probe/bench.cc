@@ -0,0 +1,159 @@
+/**
+ * @file bench.cc
+ * @brief Probe the DIMMs' internal 256-byte write granularity (the XPLine)
+ * and write-combining buffer
+ *
+ * Each thread keeps a window of random XPLines and writes to them round-robin.
+ * Writes smaller than an XPLine fill successive parts of each XPLine over
+ * several passes, so the DIMM can combine them only if the whole window fits
+ * in its buffer. Windows larger than the buffer show up as a throughput drop
+ * and, with ipmctl, a media write amplification above one. Alignment offsets
+ * shift every write within the XPLine.
+ */
+
+#include <gflags/gflags.h>
+#include <libpmem.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "../common.h"
+#include "../utils/ipmctl.h"
+#include "../utils/numa_topology.h"
+#include "../utils/parse_list.h"
+#include "../utils/pmem_region.h"
+#include "../utils/result_writer.h"
+
+DEFINE_string(pmem_file, "/dev/dax0.0",
+              "devdax device, fsdax file, or emulated region, e.g., emul:dram");
+DEFINE_uint64(region_size, GB(8), "Bytes of pmem written to");
+DEFINE_string(sizes, "8,16,32,64,128,256,512,1024,2048,4096",
+              "Comma-separated write sizes in bytes");
+DEFINE_string(offsets, "0,64,128,192",
+              "Comma-separated offsets of writes within an XPLine");
+DEFINE_string(windows, "1,2,4,8,16,32,64,128,256",
+              "Comma-separated counts of XPLines written concurrently per "
+              "thread");
+DEFINE_uint64(threads, 1, "Threads writing to disjoint parts of the region");
+DEFINE_uint64(num_writes, 200000, "Writes per thread per configuration");
+DEFINE_bool(ipmctl, true, "Report the media write ratio if ipmctl works");
+DEFINE_string(format, "csv", "Result format: csv or json");
+DEFINE_string(output_file, "",
+              "Append results to this file. Empty means stdout.");
+
+static constexpr size_t kXPLineSize = 256;
+
+struct ProbeConfig {
+  size_t size;
+  size_t offset;
+  size_t window;
+};
+
+/// Write to a window of XPLines in this thread's part of the region
+void probe_thread(uint8_t *pbuf, size_t part_size, ProbeConfig config,
+                  double *tput_GBps) {
+  uint8_t src[4096];
+  memset(src, 31, sizeof(src));
+  FastRand fast_rand;
+
+  // A slot holds all writes to one window entry, including ones that spill
+  // past the XPLine because of the offset
+  const size_t slot_size =
+      roundup<kXPLineSize>(config.offset + kXPLineSize + config.size);
+  const size_t num_slots = part_size / slot_size;
+  const size_t passes_per_epoch = std::max(1ul, kXPLineSize / config.size);
+  std::vector<size_t> slot_offsets(config.window);
+
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  size_t num_writes = 0;
+  while (num_writes < FLAGS_num_writes) {
+    // Each epoch writes a new window of XPLines until they're full
+    for (size_t &slot_offset : slot_offsets) {
+      slot_offset = (fast_rand.next_u32() % num_slots) * slot_size;
+    }
+
+    for (size_t pass = 0; pass < passes_per_epoch; pass++) {
+      const size_t intra_offset =
+          config.offset + (pass * config.size) % kXPLineSize;
+      for (size_t slot_offset : slot_offsets) {
+        src[0]++;
+        pmem_memcpy_persist(&pbuf[slot_offset + intra_offset], src,
+                            config.size);
+        emul_persist_delay(config.size);
+      }
+      num_writes += config.window;
+    }
+  }
+
+  *tput_GBps = num_writes * config.size / ns_since(start);
+}
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  const std::vector<size_t> sizes = parse_size_list(FLAGS_sizes);
+  const std::vector<size_t> offsets = parse_size_list(FLAGS_offsets);
+  const std::vector<size_t> windows = parse_size_list(FLAGS_windows);
+  for (size_t size : sizes) {
+    rt_assert(size > 0 && size <= 4096, "Sizes must be in (0, 4096]");
+  }
+  for (size_t offset : offsets) {
+    rt_assert(offset < kXPLineSize, "Offsets must be within an XPLine");
+  }
+
+  ResultWriter writer(FLAGS_format, FLAGS_output_file);
+  const PmemRegion region = map_pmem_region(FLAGS_pmem_file, FLAGS_region_size);
+  pmem_memset_persist(region.buf, 0, FLAGS_region_size);  // Fault in pages
+  const size_t part_size = FLAGS_region_size / FLAGS_threads;
+  const size_t numa_node = get_region_cpu_node(FLAGS_pmem_file, region.buf);
+
+  const bool use_ipmctl = FLAGS_ipmctl && read_dimm_counters().valid;
+  if (FLAGS_ipmctl && !use_ipmctl) {
+    fprintf(stderr, "ipmctl is unavailable. Not reporting media writes.\n");
+  }
+
+  ResultRow metadata;
+  metadata.add("pmem_file", FLAGS_pmem_file);
+  metadata.add("pmem_mode", pmem_backend_str(region.backend));
+  metadata.add("numa_node", numa_node);
+  metadata.add("threads", static_cast<size_t>(FLAGS_threads));
+  writer.write_metadata(metadata);
+
+  for (size_t window : windows) {
+    for (size_t size : sizes) {
+      for (size_t offset : offsets) {
+        const ProbeConfig config = {size, offset, window};
+        const DimmCounters before =
+            use_ipmctl ? read_dimm_counters() : DimmCounters();
+
+        std::vector<double> tput_GBps(FLAGS_threads);
+        std::vector<std::thread> threads(FLAGS_threads);
+        for (size_t i = 0; i < FLAGS_threads; i++) {
+          threads[i] = std::thread(probe_thread, region.buf + i * part_size,
+                                   part_size, config, &tput_GBps[i]);
+          bind_to_core(threads[i], numa_node, i);
+        }
+        for (auto &t : threads) t.join();
+
+        const DimmCounters after =
+            use_ipmctl ? read_dimm_counters() : DimmCounters();
+
+        ResultRow row;
+        row.add("window", window).add("size", size).add("offset", offset);
+        row.add("GBps", std::accumulate(tput_GBps.begin(), tput_GBps.end(),
+                                        0.0));
+        row.add("media_write_ratio", media_write_ratio(before, after));
+        writer.write(row);
+      }
+    }
+  }
+
+  unmap_pmem_region(region);
+  exit(0);
+}